@@ -0,0 +1,569 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "do_not_optimize.h"
+#include "perf_counters.h"
+
+/*
+ * A small benchmark harness shared by the chapters (see ch03-ranges/bench.cpp
+ * and ch06-three-way-comp/bench.cpp). Every chapter has its own executable,
+ * as the chapters have their own Version enums; the bench target runs them
+ * all and writes a JSON report per chapter.
+ *
+ * A benchmark is a name (the operation), a variant (usually the Version) and
+ * a list of input sizes. For every size the setup function builds the input,
+ * outside of the measurement, and returns a Case with the body to time.
+ *
+ * The measurement of a case:
+ * - calls shorter than a sample are run in batches, so that a sample lasts
+ *   long enough for the clock (the batch size is calibrated on the first
+ *   call); cases which need a reset before every call (e.g. a sort, which
+ *   would sort sorted data otherwise) get a batch of 1,
+ * - the first samples warm up the caches and the branch predictors and are
+ *   thrown away,
+ * - the reported times are per call: the median of the samples, their 99th
+ *   percentile (which is the maximum below 100 samples) and their minimum,
+ * - the hardware counters (see perf_counters.h) are summed over the samples
+ *   and reported per call as well; the table shows them per element, next to
+ *   the instructions per cycle.
+ *
+ * The results are printed as a table, and written as JSON with --json=FILE.
+ * A report can be kept as the baseline of later runs: with --baseline=FILE,
+ * every result is compared with the one of the same benchmark, variant and
+ * size in the baseline, and the run fails (exits with 1) if a median got
+ * slower than --max-slowdown times the baseline (1.1 by default, i.e. 10%).
+ */
+namespace bench {
+
+struct Case {
+  // the timed part
+  std::function<void()> run;
+  // called before every run, outside of the measurement, if set
+  std::function<void()> reset = {};
+};
+
+struct Benchmark {
+  std::string name;
+  std::string variant;
+  std::vector<std::size_t> sizes;
+  std::function<Case(std::size_t)> setup;
+};
+
+struct Result {
+  std::string name;
+  std::string variant;
+  std::size_t size;
+  std::size_t samples;
+  std::size_t batch;
+  // per call
+  double median_ns;
+  double p99_ns;
+  double min_ns;
+  // per call, if the counters are available
+  CounterValues counters{};
+};
+
+struct Options {
+  // only the benchmarks with "name/variant" containing it
+  std::string filter;
+  // skips the larger sizes, for a quick run
+  std::size_t max_size = ~std::size_t{0};
+  int warmup = 3;
+  int repeat = 21;
+  // a sample lasts at least this long (unless a case needs a reset)
+  double min_sample_ns = 50'000;
+  // the hardware counters, if available
+  bool counters = true;
+  // the JSON report, or nothing
+  std::string json;
+  // the report to compare with, or nothing
+  std::string baseline;
+  // the tolerated ratio of the median to the one of the baseline
+  double max_slowdown = 1.1;
+};
+
+namespace details {
+
+using Clock = std::chrono::steady_clock;
+
+inline auto elapsed_ns(Clock::time_point start) -> double {
+  return std::chrono::duration<double, std::nano>(Clock::now() - start)
+      .count();
+}
+
+// adds the counts to the totals, if there are counters
+inline auto sample(const Case &c, std::size_t batch,
+                   PerfCounters *counters = nullptr,
+                   CounterValues *totals = nullptr) -> double {
+  if (c.reset) {
+    c.reset();
+  }
+  auto probe = std::optional<PerfProbe>();
+  if (counters != nullptr) {
+    probe.emplace(*counters, *totals);
+  }
+  auto start = Clock::now();
+  for (auto i = std::size_t{0}; i < batch; ++i) {
+    c.run();
+  }
+  return elapsed_ns(start) / static_cast<double>(batch);
+}
+
+// nearest rank, of sorted times
+inline auto percentile(const std::vector<double> &times, double p) -> double {
+  auto rank = static_cast<std::size_t>(
+      std::ceil(p / 100.0 * static_cast<double>(times.size())));
+  return times[std::clamp(rank, std::size_t{1}, times.size()) - 1];
+}
+
+// control characters (e.g. a newline in a name) aren't allowed raw in JSON
+// strings, they're written as \u00XX
+inline auto json_string(std::string_view str) -> std::string {
+  constexpr auto hex = std::string_view("0123456789abcdef");
+
+  auto escaped = std::string("\"");
+  for (auto c : str) {
+    const auto byte = static_cast<unsigned char>(c);
+    if (byte < 0x20) {
+      escaped += "\\u00";
+      escaped += hex[byte >> 4];
+      escaped += hex[byte & 0xf];
+      continue;
+    }
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+    }
+    escaped += c;
+  }
+  return escaped + '"';
+}
+
+inline auto cpu_model() -> std::string {
+  auto cpuinfo = std::ifstream("/proc/cpuinfo");
+  for (auto line = std::string(); std::getline(cpuinfo, line);) {
+    auto colon = line.find(':');
+    if (line.starts_with("model name") && colon != std::string::npos) {
+      return line.substr(std::min(colon + 2, line.size()));
+    }
+  }
+  return "unknown CPU";
+}
+
+inline auto parse_ratio(std::string_view str) -> double {
+  auto value = 0.0;
+  auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+  if (ec != std::errc() || ptr != str.data() + str.size()) {
+    std::fprintf(stderr, "invalid number: %.*s\n",
+                 static_cast<int>(str.size()), str.data());
+    std::exit(2);
+  }
+  return value;
+}
+
+// the reverse of json_string; \uXXXX beyond ASCII is decoded to UTF-8
+inline auto json_unescape(std::string_view str) -> std::string {
+  auto unescaped = std::string();
+  for (auto i = std::size_t{0}; i < str.size(); ++i) {
+    if (str[i] == '\\' && i + 1 < str.size()) {
+      ++i;
+      auto code = 0u;
+      if (str[i] == 'u' && i + 4 < str.size() &&
+          std::from_chars(&str[i + 1], &str[i + 5], code, 16).ptr ==
+              &str[i + 5]) {
+        i += 4;
+        if (code < 0x80) {
+          unescaped += static_cast<char>(code);
+        } else if (code < 0x800) {
+          unescaped += static_cast<char>(0xc0 | (code >> 6));
+          unescaped += static_cast<char>(0x80 | (code & 0x3f));
+        } else {
+          unescaped += static_cast<char>(0xe0 | (code >> 12));
+          unescaped += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+          unescaped += static_cast<char>(0x80 | (code & 0x3f));
+        }
+        continue;
+      }
+    }
+    unescaped += str[i];
+  }
+  return unescaped;
+}
+
+// the raw value of "key": value in the line (without the quotes of strings)
+inline auto json_field(std::string_view line, std::string_view key)
+    -> std::optional<std::string_view> {
+  auto pattern = "\"" + std::string(key) + "\": ";
+  auto pos = line.find(pattern);
+  if (pos == std::string_view::npos) {
+    return std::nullopt;
+  }
+  auto value = line.substr(pos + pattern.size());
+  if (value.starts_with('"')) {
+    for (auto i = std::size_t{1}; i < value.size(); ++i) {
+      if (value[i] == '\\') {
+        ++i;
+      } else if (value[i] == '"') {
+        return value.substr(1, i - 1);
+      }
+    }
+    return std::nullopt;
+  }
+  return value.substr(0, value.find_first_of(",}"));
+}
+
+inline auto parse_number(std::string_view str) -> std::size_t {
+  auto value = std::size_t{0};
+  auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+  if (ec != std::errc()) {
+    std::fprintf(stderr, "invalid number: %.*s\n",
+                 static_cast<int>(str.size()), str.data());
+    std::exit(2);
+  }
+  // 1K, 50M and the like
+  auto suffix = std::string_view(ptr, str.data() + str.size());
+  return suffix == "K"   ? value * 1'000
+         : suffix == "M" ? value * 1'000'000
+                         : value;
+}
+
+} // namespace details
+
+inline auto measure(const Benchmark &benchmark, std::size_t size,
+                    const Options &options, PerfCounters *counters = nullptr)
+    -> Result {
+  using namespace details;
+
+  const auto c = benchmark.setup(size);
+
+  auto batch = std::size_t{1};
+  if (!c.reset) {
+    auto once = std::max(sample(c, 1), 1.0);
+    batch = static_cast<std::size_t>(
+        std::clamp(options.min_sample_ns / once, 1.0, 1e9));
+  }
+
+  for (auto i = 0; i < options.warmup; ++i) {
+    sample(c, batch);
+  }
+  auto times = std::vector<double>();
+  auto totals = CounterValues();
+  for (auto i = 0; i < std::max(options.repeat, 1); ++i) {
+    times.push_back(sample(c, batch, counters, &totals));
+  }
+  std::ranges::sort(times);
+
+  const auto calls = static_cast<double>(times.size() * batch);
+  for (auto &total : totals) {
+    if (total) {
+      *total /= calls;
+    }
+  }
+
+  return {benchmark.name,         benchmark.variant,
+          size,                   times.size(),
+          batch,                  percentile(times, 50),
+          percentile(times, 99),  times.front(),
+          totals};
+}
+
+namespace details {
+
+inline auto print_header(bool counters) -> void {
+  std::printf("%-28s %-10s %10s %8s %12s %12s %12s", "benchmark", "variant",
+              "size", "batch", "median ns", "p99 ns", "ns/elem");
+  if (counters) {
+    std::printf(" %6s %10s %10s %10s %10s", "IPC", "brmiss/el", "L1miss/el",
+                "LLCmiss/el", "TLBmiss/el");
+  }
+  std::printf("\n");
+}
+
+inline auto print_result(const Result &result, bool counters) -> void {
+  const auto elements =
+      static_cast<double>(std::max(result.size, std::size_t{1}));
+  std::printf("%-28s %-10s %10zu %8zu %12.1f %12.1f %12.3f",
+              result.name.c_str(), result.variant.c_str(), result.size,
+              result.batch, result.median_ns, result.p99_ns,
+              result.median_ns / elements);
+  if (counters) {
+    auto cycles = value_of(result.counters, Counter::Cycles);
+    auto instructions = value_of(result.counters, Counter::Instructions);
+    if (cycles && instructions && *cycles > 0) {
+      std::printf(" %6.2f", *instructions / *cycles);
+    } else {
+      std::printf(" %6s", "-");
+    }
+    for (auto counter : {Counter::BranchMisses, Counter::L1dMisses,
+                         Counter::LlcMisses, Counter::DtlbMisses}) {
+      if (auto value = value_of(result.counters, counter)) {
+        std::printf(" %10.3f", *value / elements);
+      } else {
+        std::printf(" %10s", "-");
+      }
+    }
+  }
+  std::printf("\n");
+  std::fflush(stdout);
+}
+
+} // namespace details
+
+class Registry {
+  std::vector<Benchmark> benchmarks_;
+
+public:
+  auto add(Benchmark benchmark) -> void {
+    benchmarks_.push_back(std::move(benchmark));
+  }
+
+  /*
+   * Adds a benchmark per version, like
+   *   registry.add<Version::Iterator, Version::Ranges>(
+   *       "sort", sizes, version_name,
+   *       []<Version version>(std::size_t size) -> bench::Case { ... });
+   */
+  template <auto... version, typename NameOf, typename Setup>
+  auto add(const std::string &name, const std::vector<std::size_t> &sizes,
+           NameOf name_of, Setup setup) -> void {
+    (add({name, std::string(name_of(version)), sizes,
+          [setup](std::size_t size) {
+            return setup.template operator()<version>(size);
+          }}),
+     ...);
+  }
+
+  auto benchmarks() const -> const std::vector<Benchmark> & {
+    return benchmarks_;
+  }
+
+  // runs the matching benchmarks, printing the results as they come
+  auto run(const Options &options) const -> std::vector<Result> {
+    auto counters = std::optional<PerfCounters>();
+    if (options.counters) {
+      counters.emplace();
+      if (!counters->available()) {
+        std::fprintf(stderr, "no hardware counters (not permitted or not "
+                             "supported), timings only\n");
+        counters.reset();
+      }
+    }
+
+    auto results = std::vector<Result>();
+    details::print_header(counters.has_value());
+    for (const auto &benchmark : benchmarks_) {
+      auto full_name = benchmark.name + "/" + benchmark.variant;
+      if (full_name.find(options.filter) == std::string::npos) {
+        continue;
+      }
+      for (auto size : benchmark.sizes) {
+        if (size > options.max_size) {
+          continue;
+        }
+        const auto &result = results.emplace_back(measure(
+            benchmark, size, options, counters ? &*counters : nullptr));
+        details::print_result(result, counters.has_value());
+      }
+    }
+    return results;
+  }
+};
+
+/*
+ * The report: the context of the run (to tell apart the results of different
+ * machines and builds when tracking them over time) and the results.
+ */
+inline auto write_json(std::ostream &out, std::string_view executable,
+                       const std::vector<Result> &results) -> void {
+  using namespace details;
+
+  auto now = std::chrono::system_clock::now();
+  out << std::fixed << std::setprecision(1);
+  out << "{\n  \"context\": {\n"
+      << "    \"executable\": " << json_string(executable) << ",\n"
+      << "    \"time\": "
+      << std::chrono::duration_cast<std::chrono::seconds>(
+             now.time_since_epoch())
+             .count()
+      << ",\n"
+      << "    \"cpu\": " << json_string(cpu_model()) << ",\n"
+#if defined(__VERSION__)
+      << "    \"compiler\": " << json_string(__VERSION__) << ",\n"
+#endif
+#if defined(NDEBUG)
+      << "    \"assertions\": false\n"
+#else
+      << "    \"assertions\": true\n"
+#endif
+      << "  },\n  \"benchmarks\": [";
+
+  for (auto i = std::size_t{0}; i < results.size(); ++i) {
+    const auto &result = results[i];
+    out << (i == 0 ? "\n" : ",\n") << "    {\"name\": "
+        << json_string(result.name)
+        << ", \"variant\": " << json_string(result.variant)
+        << ", \"size\": " << result.size << ", \"samples\": " << result.samples
+        << ", \"batch\": " << result.batch
+        << ", \"median_ns\": " << result.median_ns
+        << ", \"p99_ns\": " << result.p99_ns
+        << ", \"min_ns\": " << result.min_ns;
+    // per call, only the available ones
+    auto separator = ", \"counters\": {";
+    for (auto counter : all_counters) {
+      if (auto value = value_of(result.counters, counter)) {
+        out << std::exchange(separator, ", ")
+            << json_string(counter_name(counter)) << ": " << *value;
+      }
+    }
+    out << (std::string_view(separator) == ", " ? "}}" : "}");
+  }
+  out << "\n  ]\n}\n";
+}
+
+/*
+ * Reads the results back from a report of write_json. It's not a JSON parser:
+ * it relies on write_json putting every result on its own line.
+ */
+inline auto read_json(const std::string &path) -> std::vector<Result> {
+  using namespace details;
+
+  auto file = std::ifstream(path);
+  if (!file) {
+    std::fprintf(stderr, "cannot read %s\n", path.c_str());
+    std::exit(2);
+  }
+  auto results = std::vector<Result>();
+  for (auto line = std::string(); std::getline(file, line);) {
+    auto name = json_field(line, "name");
+    auto variant = json_field(line, "variant");
+    auto size = json_field(line, "size");
+    auto median = json_field(line, "median_ns");
+    if (!name || !variant || !size || !median) {
+      continue;
+    }
+    auto &result = results.emplace_back();
+    result.name = json_unescape(*name);
+    result.variant = json_unescape(*variant);
+    result.size = parse_number(*size);
+    result.median_ns = parse_ratio(*median);
+  }
+  return results;
+}
+
+/*
+ * Prints the results next to the baseline; returns false if a result got
+ * slower than tolerated. The results which aren't in the baseline (e.g. new
+ * benchmarks) pass.
+ */
+inline auto compare_with_baseline(const std::vector<Result> &results,
+                                  const std::vector<Result> &baseline,
+                                  double max_slowdown) -> bool {
+  std::printf("\n%-28s %-10s %10s %12s %12s %8s\n", "benchmark", "variant",
+              "size", "baseline ns", "median ns", "ratio");
+  auto passed = true;
+  for (const auto &result : results) {
+    auto it = std::ranges::find_if(baseline, [&](const Result &base) {
+      return base.name == result.name && base.variant == result.variant &&
+             base.size == result.size;
+    });
+    if (it == baseline.end() || it->median_ns <= 0) {
+      std::printf("%-28s %-10s %10zu %12s %12.1f %8s\n", result.name.c_str(),
+                  result.variant.c_str(), result.size, "-", result.median_ns,
+                  "new");
+      continue;
+    }
+    auto ratio = result.median_ns / it->median_ns;
+    auto slower = ratio > max_slowdown;
+    passed = passed && !slower;
+    std::printf("%-28s %-10s %10zu %12.1f %12.1f %8.3f%s\n",
+                result.name.c_str(), result.variant.c_str(), result.size,
+                it->median_ns, result.median_ns, ratio,
+                slower ? "  SLOWER" : "");
+  }
+  if (!passed) {
+    std::printf("slower than %.3f times the baseline\n", max_slowdown);
+  }
+  return passed;
+}
+
+inline auto parse_options(int argc, char *argv[]) -> Options {
+  using details::parse_number;
+
+  auto options = Options();
+  for (auto i = 1; i < argc; ++i) {
+    auto arg = std::string_view(argv[i]);
+    if (arg.starts_with("--filter=")) {
+      options.filter = arg.substr(9);
+    } else if (arg.starts_with("--max-size=")) {
+      options.max_size = parse_number(arg.substr(11));
+    } else if (arg.starts_with("--warmup=")) {
+      options.warmup = static_cast<int>(parse_number(arg.substr(9)));
+    } else if (arg.starts_with("--repeat=")) {
+      options.repeat = static_cast<int>(parse_number(arg.substr(9)));
+    } else if (arg.starts_with("--json=")) {
+      options.json = arg.substr(7);
+    } else if (arg == "--no-counters") {
+      options.counters = false;
+    } else if (arg.starts_with("--baseline=")) {
+      options.baseline = arg.substr(11);
+    } else if (arg.starts_with("--max-slowdown=")) {
+      options.max_slowdown = details::parse_ratio(arg.substr(15));
+    } else {
+      std::fprintf(stderr,
+                   "usage: %s [--filter=NAME] [--max-size=N] [--warmup=N] "
+                   "[--repeat=N] [--json=FILE] [--no-counters]\n"
+                   "       [--baseline=FILE] [--max-slowdown=RATIO]\n",
+                   argv[0]);
+      std::exit(2);
+    }
+  }
+  return options;
+}
+
+/*
+ * The whole main of a benchmark executable:
+ *   int main(int argc, char *argv[]) {
+ *     return bench::main(argc, argv, registry());
+ *   }
+ */
+inline auto main(int argc, char *argv[], const Registry &registry) -> int {
+  auto options = parse_options(argc, argv);
+  // read first, the report may be written over the baseline
+  auto baseline = std::vector<Result>();
+  if (!options.baseline.empty()) {
+    baseline = read_json(options.baseline);
+  }
+
+  auto results = registry.run(options);
+
+  if (!options.json.empty()) {
+    auto file = std::ofstream(options.json, std::ios::trunc);
+    write_json(file, argv[0], results);
+    if (!file.flush()) {
+      std::fprintf(stderr, "cannot write %s\n", options.json.c_str());
+      return 1;
+    }
+  }
+
+  if (!options.baseline.empty() &&
+      !compare_with_baseline(results, baseline, options.max_slowdown)) {
+    return 1;
+  }
+  return 0;
+}
+
+} // namespace bench
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bench.h"
+
+/*
+ * Differential testing of the Version variants: the compile-time tests of the
+ * headers only cover a few tiny inputs, so here every variant of an operation
+ * runs on large random inputs, and has to give the same result as the first
+ * variant. A new fast variant is then checked against the plain one on inputs
+ * nobody would write by hand.
+ *
+ * Every input is generated from a seed, so a mismatch is reproducible: the
+ * report names the seed and the size, and
+ *   --filter=NAME --seed=SEED --seeds=1 --max-size=SIZE
+ * runs just that input again.
+ *
+ * Where the result of an operation is allowed to differ between variants
+ * (e.g. the order of equal keys after an unstable sort), a normalization
+ * makes the results comparable, without hiding real differences.
+ *
+ * The runtime tests of a chapter (the ones which write files or start
+ * threads, so can't be compile-time tests) run here too, before the checks:
+ * they throw on a failure.
+ */
+namespace bench {
+
+struct DifferentialCheck {
+  std::string name;
+  std::vector<std::size_t> sizes;
+  // the mismatches on the input of the seed and the size, as messages
+  std::function<std::vector<std::string>(std::uint64_t, std::size_t)> run;
+};
+
+struct DifferentialOptions {
+  // only the checks with the name containing it
+  std::string filter;
+  // skips the larger sizes, for a quick run
+  std::size_t max_size = ~std::size_t{0};
+  // the first seed, and how many seeds (inputs) per size
+  std::uint64_t seed = 1;
+  std::size_t seeds = 10;
+};
+
+struct RuntimeTest {
+  std::string name;
+  std::function<void()> run;
+};
+
+class Differential {
+  std::vector<RuntimeTest> tests_;
+  std::vector<DifferentialCheck> checks_;
+
+public:
+  /*
+   * Adds a check of the given versions, like
+   *   differential.add<Version::Ranges, Version::Parallel>(
+   *       "hash_join", sizes, version_name,
+   *       [](std::mt19937_64 &rng, std::size_t size) { return input; },
+   *       []<Version version>(Input input) { return output; },
+   *       [](Output output) { return normalized; });
+   *
+   * The run function gets its own copy of the input, so it can change it.
+   */
+  template <auto... version, typename NameOf, typename Generate,
+            typename Run, typename Normalize = std::identity>
+    requires(sizeof...(version) >= 2)
+  auto add(std::string name, std::vector<std::size_t> sizes, NameOf name_of,
+           Generate generate, Run run, Normalize normalize = {}) -> void {
+    auto check = [=](std::uint64_t seed, std::size_t size) {
+      auto rng = std::mt19937_64(seed);
+      const auto input = generate(rng, size);
+
+      const auto names = std::array{std::string(name_of(version))...};
+      const auto outputs =
+          std::vector{normalize(run.template operator()<version>(input))...};
+
+      auto mismatches = std::vector<std::string>();
+      for (auto i = std::size_t{1}; i < outputs.size(); ++i) {
+        if (!(outputs[i] == outputs[0])) {
+          mismatches.push_back(names[i] + " differs from " + names[0]);
+        }
+      }
+      return mismatches;
+    };
+    checks_.push_back({std::move(name), std::move(sizes), std::move(check)});
+  }
+
+  // a test failing with an exception
+  auto add_test(std::string name, std::function<void()> test) -> void {
+    tests_.push_back({std::move(name), std::move(test)});
+  }
+
+  // returns whether all the tests passed, and all the variants agreed on all
+  // the inputs
+  auto run(const DifferentialOptions &options) const -> bool {
+    auto passed = true;
+    for (const auto &test : tests_) {
+      if (test.name.find(options.filter) == std::string::npos) {
+        continue;
+      }
+      try {
+        test.run();
+        std::printf("%-28s %10s ok\n", test.name.c_str(), "test");
+      } catch (const std::exception &e) {
+        std::printf("%-28s %10s FAILED: %s\n", test.name.c_str(), "test",
+                    e.what());
+        passed = false;
+      }
+      std::fflush(stdout);
+    }
+
+    for (const auto &check : checks_) {
+      if (check.name.find(options.filter) == std::string::npos) {
+        continue;
+      }
+      for (auto size : check.sizes) {
+        if (size > options.max_size) {
+          continue;
+        }
+        auto failures = std::size_t{0};
+        for (auto seed = options.seed; seed < options.seed + options.seeds;
+             ++seed) {
+          for (const auto &mismatch : check.run(seed, size)) {
+            std::printf("MISMATCH %s: %s (seed %llu, size %zu)\n",
+                        check.name.c_str(), mismatch.c_str(),
+                        static_cast<unsigned long long>(seed), size);
+            ++failures;
+          }
+        }
+        std::printf("%-28s %10zu %s\n", check.name.c_str(), size,
+                    failures == 0 ? "ok" : "FAILED");
+        std::fflush(stdout);
+        passed = passed && failures == 0;
+      }
+    }
+    return passed;
+  }
+};
+
+inline auto parse_differential_options(int argc, char *argv[])
+    -> DifferentialOptions {
+  using details::parse_number;
+
+  auto options = DifferentialOptions();
+  for (auto i = 1; i < argc; ++i) {
+    auto arg = std::string_view(argv[i]);
+    if (arg.starts_with("--filter=")) {
+      options.filter = arg.substr(9);
+    } else if (arg.starts_with("--max-size=")) {
+      options.max_size = parse_number(arg.substr(11));
+    } else if (arg.starts_with("--seed=")) {
+      options.seed = parse_number(arg.substr(7));
+    } else if (arg.starts_with("--seeds=")) {
+      options.seeds = parse_number(arg.substr(8));
+    } else {
+      std::fprintf(stderr,
+                   "usage: %s [--filter=NAME] [--max-size=N] [--seed=N] "
+                   "[--seeds=N]\n",
+                   argv[0]);
+      std::exit(2);
+    }
+  }
+  return options;
+}
+
+/*
+ * The whole main of a differential testing executable; exits with 1 on a
+ * mismatch.
+ */
+inline auto differential_main(int argc, char *argv[],
+                              const Differential &differential) -> int {
+  return differential.run(parse_differential_options(argc, argv)) ? 0 : 1;
+}
+
+} // namespace bench
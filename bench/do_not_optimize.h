@@ -0,0 +1,20 @@
+#pragma once
+
+namespace bench {
+
+/*
+ * Makes the compiler assume that the value is read and written, so that it
+ * can't drop the computation of the value, or move it out of the timed loop.
+ * Shared by the benchmark harness (bench.h) and the measurements of the
+ * ch03 autotuner.
+ */
+template <typename T> inline auto do_not_optimize(T &value) -> void {
+#if defined(__GNUC__)
+  asm volatile("" : : "g"(&value) : "memory");
+#else
+  static const void *volatile sink;
+  sink = &value;
+#endif
+}
+
+} // namespace bench
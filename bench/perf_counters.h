@@ -0,0 +1,231 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Hardware performance counters, which tell why a variant is faster than
+ * another: fewer instructions, more instructions per cycle, fewer branch
+ * mispredictions or cache misses...
+ *
+ * On Linux they come from perf_event_open. Every counter is opened on its own,
+ * so that a counter the CPU (or the hypervisor) doesn't have doesn't take the
+ * others down with it. Counters are often not permitted at all (see
+ * /proc/sys/kernel/perf_event_paranoid, or the seccomp profile of a
+ * container); then available() is false and every count is nullopt, and the
+ * caller goes on with the timings only. Elsewhere there are no counters.
+ *
+ * Only user space is counted, which is all an unprivileged process may count
+ * anyway. The threads started while counting (by the parallel versions) are
+ * counted too.
+ */
+namespace bench {
+
+enum class Counter {
+  Cycles,
+  Instructions,
+  BranchMisses,
+  L1dMisses,
+  LlcMisses,
+  DtlbMisses,
+};
+
+constexpr auto all_counters = std::to_array<Counter>({
+    Counter::Cycles,
+    Counter::Instructions,
+    Counter::BranchMisses,
+    Counter::L1dMisses,
+    Counter::LlcMisses,
+    Counter::DtlbMisses,
+});
+
+constexpr auto counter_name(Counter counter) -> std::string_view {
+  switch (counter) {
+  case Counter::Cycles:
+    return "cycles";
+  case Counter::Instructions:
+    return "instructions";
+  case Counter::BranchMisses:
+    return "branch_misses";
+  case Counter::L1dMisses:
+    return "l1d_misses";
+  case Counter::LlcMisses:
+    return "llc_misses";
+  case Counter::DtlbMisses:
+    return "dtlb_misses";
+  }
+  return "?";
+}
+
+// indexed by Counter; nullopt for the counters which aren't available
+using CounterValues = std::array<std::optional<double>, all_counters.size()>;
+
+constexpr auto value_of(const CounterValues &values, Counter counter)
+    -> std::optional<double> {
+  return values[static_cast<std::size_t>(counter)];
+}
+
+class PerfCounters {
+  std::array<int, all_counters.size()> fds_;
+
+#if defined(__linux__)
+  static auto open(Counter counter) -> int {
+    auto attr = perf_event_attr();
+    attr.size = sizeof(attr);
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // the kernel multiplexes the counters when there are more than the CPU
+    // has registers for; the times tell how to scale the counts then
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    auto cache_miss = [&attr](std::uint64_t cache) {
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = cache | PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                    PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+    };
+    switch (counter) {
+    case Counter::Cycles:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case Counter::Instructions:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case Counter::BranchMisses:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+      break;
+    case Counter::L1dMisses:
+      cache_miss(PERF_COUNT_HW_CACHE_L1D);
+      break;
+    case Counter::LlcMisses:
+      cache_miss(PERF_COUNT_HW_CACHE_LL);
+      break;
+    case Counter::DtlbMisses:
+      cache_miss(PERF_COUNT_HW_CACHE_DTLB);
+      break;
+    }
+
+    // this thread (and its future children), any CPU
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1,
+                                    PERF_FLAG_FD_CLOEXEC));
+  }
+#endif
+
+public:
+  PerfCounters() {
+    fds_.fill(-1);
+#if defined(__linux__)
+    for (auto counter : all_counters) {
+      fds_[static_cast<std::size_t>(counter)] = open(counter);
+    }
+#endif
+  }
+
+  ~PerfCounters() {
+#if defined(__linux__)
+    for (auto fd : fds_) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+#endif
+  }
+
+  PerfCounters(const PerfCounters &) = delete;
+  auto operator=(const PerfCounters &) -> PerfCounters & = delete;
+
+  auto available(Counter counter) const -> bool {
+    return fds_[static_cast<std::size_t>(counter)] >= 0;
+  }
+
+  auto available() const -> bool {
+    for (auto fd : fds_) {
+      if (fd >= 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  auto start() -> void {
+#if defined(__linux__)
+    for (auto fd : fds_) {
+      if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+#endif
+  }
+
+  // the counts since start()
+  auto stop() -> CounterValues {
+    auto values = CounterValues();
+#if defined(__linux__)
+    for (auto fd : fds_) {
+      if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      }
+    }
+    for (auto i = std::size_t{0}; i < fds_.size(); ++i) {
+      // value, time enabled, time running
+      auto data = std::array<std::uint64_t, 3>();
+      if (fds_[i] < 0 ||
+          read(fds_[i], data.data(), sizeof(data)) != sizeof(data) ||
+          data[2] == 0) {
+        continue;
+      }
+      values[i] = static_cast<double>(data[0]) *
+                  static_cast<double>(data[1]) / static_cast<double>(data[2]);
+    }
+#endif
+    return values;
+  }
+};
+
+/*
+ * Counts for its own lifetime, adding the counts to the totals:
+ *
+ *   {
+ *     auto probe = PerfProbe(counters, totals);
+ *     ... the measured code ...
+ *   }
+ */
+class PerfProbe {
+  PerfCounters &counters_;
+  CounterValues &totals_;
+
+public:
+  PerfProbe(PerfCounters &counters, CounterValues &totals)
+      : counters_(counters), totals_(totals) {
+    counters_.start();
+  }
+
+  ~PerfProbe() {
+    auto values = counters_.stop();
+    for (auto i = std::size_t{0}; i < values.size(); ++i) {
+      if (values[i]) {
+        totals_[i] = totals_[i].value_or(0.0) + *values[i];
+      }
+    }
+  }
+
+  PerfProbe(const PerfProbe &) = delete;
+  auto operator=(const PerfProbe &) -> PerfProbe & = delete;
+};
+
+} // namespace bench
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <ranges>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "sort_books.h"
+
+/*
+ * sorted<version> in sort_books.h copies the whole range and then swaps the
+ * elements around. For books, that's two strings per swap. Here we sort
+ * indices instead: the resulting permutation says which element of the
+ * original range goes to which position, i.e. sorted[i] == range[perm[i]].
+ *
+ * The permutation is 4 bytes per element no matter how heavy the elements are,
+ * so it's cheap to build, to swap around and to keep next to the original.
+ * The price is a limit of 2^32 - 1 elements (which is 4G books, way more than
+ * fits in memory anyway); argsort throws std::length_error beyond it.
+ */
+template <std::ranges::random_access_range R, typename Proj = std::identity>
+constexpr auto argsort(const R &range, Proj proj = {})
+    -> std::vector<std::uint32_t> {
+  const auto size = static_cast<std::size_t>(std::ranges::size(range));
+  if (size > std::numeric_limits<std::uint32_t>::max()) {
+    throw std::length_error("argsort: too many elements for 32-bit indices");
+  }
+
+  auto perm = std::vector<std::uint32_t>(size);
+  std::iota(perm.begin(), perm.end(), std::uint32_t{0});
+
+  // decltype(auto) is important here: with a plain auto the projection result
+  // (e.g. the title) would be copied on every comparison
+  auto key = [&](std::uint32_t i) -> decltype(auto) {
+    return std::invoke(proj, std::ranges::begin(range)[i]);
+  };
+
+  // equal keys are ordered by their original position, so the result is the
+  // same as with a stable sort, but std::ranges::sort stays usable at compile
+  // time (std::stable_sort isn't constexpr)
+  std::ranges::sort(perm, [&](std::uint32_t lhs, std::uint32_t rhs) {
+    const auto &l = key(lhs);
+    const auto &r = key(rhs);
+    if (l < r) {
+      return true;
+    }
+    if (r < l) {
+      return false;
+    }
+    return lhs < rhs;
+  });
+
+  return perm;
+}
+
+/*
+ * Rearranges the range in place according to the permutation, so that
+ * range[i] becomes the old range[perm[i]].
+ *
+ * The permutation is walked cycle by cycle: the first element of a cycle is
+ * moved out to a temporary, then every other element of the cycle is moved
+ * straight to its final place, and the temporary closes the cycle. So each
+ * element is moved exactly once (plus one extra move per cycle for the
+ * temporary), instead of 3 moves per swap.
+ *
+ * The permutation is taken by value, since we use it to mark visited
+ * positions (perm[i] == i means "already in place").
+ */
+template <std::ranges::random_access_range R>
+constexpr auto apply_permutation(R &&range, std::vector<std::uint32_t> perm)
+    -> void {
+  auto first = std::ranges::begin(range);
+
+  for (auto start = std::uint32_t{0}; start < perm.size(); ++start) {
+    if (perm[start] == start) {
+      continue;
+    }
+
+    auto tmp = std::ranges::iter_move(first + start);
+    auto current = start;
+
+    while (perm[current] != start) {
+      auto next = perm[current];
+      first[current] = std::ranges::iter_move(first + next);
+      perm[current] = current;
+      current = next;
+    }
+
+    first[current] = std::move(tmp);
+    perm[current] = current;
+  }
+}
+
+/*
+ * A view that presents a range in sorted order without touching (or copying)
+ * the range itself. The only thing it owns is the permutation.
+ *
+ * Like custom_take_view, we derive from view_interface to get empty(), size(),
+ * operator[] and friends for free, and only implement begin and end.
+ */
+template <std::ranges::view R>
+  requires std::ranges::random_access_range<R>
+class sorted_view : public std::ranges::view_interface<sorted_view<R>> {
+  R base_;
+  std::vector<std::uint32_t> perm_;
+
+  /*
+   * The iterator is just an iterator over the permutation, which dereferences
+   * through the base range.
+   */
+  template <bool Const> class iterator {
+    using Base = std::conditional_t<Const, const R, R>;
+    using BaseIt = std::ranges::iterator_t<Base>;
+    using PermIt = std::vector<std::uint32_t>::const_iterator;
+
+    BaseIt first_{};
+    PermIt current_{};
+
+  public:
+    using iterator_concept = std::random_access_iterator_tag;
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = std::ranges::range_value_t<Base>;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+    constexpr iterator(BaseIt first, PermIt current)
+        : first_(first), current_(current) {}
+
+    constexpr auto operator*() const -> std::ranges::range_reference_t<Base> {
+      return first_[*current_];
+    }
+    constexpr auto operator[](difference_type n) const
+        -> std::ranges::range_reference_t<Base> {
+      return first_[current_[n]];
+    }
+
+    constexpr auto operator++() -> iterator & {
+      ++current_;
+      return *this;
+    }
+    constexpr auto operator++(int) -> iterator {
+      auto copy = *this;
+      ++current_;
+      return copy;
+    }
+    constexpr auto operator--() -> iterator & {
+      --current_;
+      return *this;
+    }
+    constexpr auto operator--(int) -> iterator {
+      auto copy = *this;
+      --current_;
+      return copy;
+    }
+    constexpr auto operator+=(difference_type n) -> iterator & {
+      current_ += n;
+      return *this;
+    }
+    constexpr auto operator-=(difference_type n) -> iterator & {
+      current_ -= n;
+      return *this;
+    }
+
+    friend constexpr auto operator+(iterator it, difference_type n)
+        -> iterator {
+      return it += n;
+    }
+    friend constexpr auto operator+(difference_type n, iterator it)
+        -> iterator {
+      return it += n;
+    }
+    friend constexpr auto operator-(iterator it, difference_type n)
+        -> iterator {
+      return it -= n;
+    }
+    friend constexpr auto operator-(const iterator &lhs, const iterator &rhs)
+        -> difference_type {
+      return lhs.current_ - rhs.current_;
+    }
+
+    // only the position in the permutation matters for comparisons, and
+    // thanks to C++20 these two operators give us all six
+    friend constexpr auto operator==(const iterator &lhs, const iterator &rhs)
+        -> bool {
+      return lhs.current_ == rhs.current_;
+    }
+    friend constexpr auto operator<=>(const iterator &lhs,
+                                      const iterator &rhs) {
+      return lhs.current_ <=> rhs.current_;
+    }
+  };
+
+public:
+  sorted_view() = default;
+
+  // sorts by the projection right away
+  template <typename Proj = std::identity>
+  constexpr explicit sorted_view(R base, Proj proj = {})
+      : base_(std::move(base)), perm_(argsort(base_, std::move(proj))) {}
+
+  // reuses an existing permutation (e.g. one obtained with argsort earlier)
+  constexpr sorted_view(R base, std::vector<std::uint32_t> perm)
+      : base_(std::move(base)), perm_(std::move(perm)) {}
+
+  constexpr R base() const & { return base_; }
+  constexpr R base() && { return std::move(base_); }
+
+  constexpr auto permutation() const -> const std::vector<std::uint32_t> & {
+    return perm_;
+  }
+
+  constexpr auto begin() {
+    return iterator<false>(std::ranges::begin(base_), perm_.begin());
+  }
+  constexpr auto end() {
+    return iterator<false>(std::ranges::begin(base_), perm_.end());
+  }
+
+  constexpr auto begin() const
+    requires std::ranges::random_access_range<const R>
+  {
+    return iterator<true>(std::ranges::begin(base_), perm_.begin());
+  }
+  constexpr auto end() const
+    requires std::ranges::random_access_range<const R>
+  {
+    return iterator<true>(std::ranges::begin(base_), perm_.end());
+  }
+};
+
+// same trick as for custom_take_view: always store a view of the range
+template <std::ranges::range R, typename Proj>
+sorted_view(R &&, Proj) -> sorted_view<std::views::all_t<R>>;
+
+template <std::ranges::range R>
+sorted_view(R &&) -> sorted_view<std::views::all_t<R>>;
+
+static_assert(std::ranges::random_access_range<
+              sorted_view<std::ranges::ref_view<std::vector<int>>>>);
+
+/*
+ * Compile-time tests
+ */
+namespace argsort_test {
+
+using Book = Book<std::string_view>;
+
+constexpr auto input = std::to_array<Book>({
+    {"Functional programming in C++", "978-3-20-148410-0"},
+    {"Effective C++", "978-3-16-148410-0"},
+    {"C++ Concurrency in Action", "978-1-61-729469-3"},
+    {"Effective C++", "978-0-32-133487-9"},
+});
+
+constexpr auto expected = std::to_array<Book>({
+    {"C++ Concurrency in Action", "978-1-61-729469-3"},
+    {"Effective C++", "978-3-16-148410-0"},
+    {"Effective C++", "978-0-32-133487-9"},
+    {"Functional programming in C++", "978-3-20-148410-0"},
+});
+
+consteval auto test_argsort() -> bool {
+  // ties keep their original order
+  auto perm = argsort(input, &Book::title);
+  return std::ranges::equal(perm, std::array{2u, 1u, 3u, 0u});
+}
+
+consteval auto test_sorted_view() -> bool {
+  auto view = sorted_view(input, &Book::title);
+  return std::ranges::equal(view, expected) && view[0] == expected[0] &&
+         static_cast<std::size_t>(view.size()) == expected.size();
+}
+
+consteval auto test_apply_permutation() -> bool {
+  auto books = input;
+  apply_permutation(books, argsort(books, &Book::title));
+  return std::ranges::equal(books, expected);
+}
+
+static_assert(test_argsort());
+static_assert(test_sorted_view());
+static_assert(test_apply_permutation());
+
+} // namespace argsort_test
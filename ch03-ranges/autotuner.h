@@ -0,0 +1,652 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <ranges>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "dedupe_books.h"
+#include "do_not_optimize.h"
+#include "hash_join.h"
+#include "odd_numbers.h"
+#include "random_books.h"
+#include "runtime_check.h"
+#include "sort_books.h"
+#include "strings_equal.h"
+#include "temp_file.h"
+#include "version.h"
+
+/*
+ * Which Version of an operation is the fastest depends on the machine (vector
+ * width, number of cores, cache sizes) and on the size of the input: the
+ * parallel versions only pay off once the input is large enough to cover the
+ * cost of starting the threads, the SIMD compare once the strings are longer
+ * than a vector, and so on.
+ *
+ * The autotuner is a registry of operations, each with its Version
+ * implementations. tune() runs every implementation on generated inputs of a
+ * few size classes and records the fastest one per class; calling the
+ * operation then dispatches to the winner for the size class of the input.
+ *
+ * Tuning takes a few seconds, so the winners are saved to a cache file, keyed
+ * by the CPU model, and loaded on the next start:
+ *
+ *   auto tuner = default_autotuner();
+ *   tuner.load_or_tune(cache_dir / "ch03-autotune.txt");
+ *
+ *   auto &sort = tuner.operation<std::vector<Book<std::string>>>("sort");
+ *   sort(books);
+ */
+namespace autotune_details {
+
+/*
+ * Inputs of up to size_classes[i] elements belong to class i, larger ones to
+ * the last class. The implementations are measured at exactly these sizes.
+ */
+constexpr auto size_classes =
+    std::to_array<std::size_t>({64, 4096, std::size_t{1} << 18});
+
+constexpr auto size_class_of(std::size_t size) -> std::size_t {
+  auto it = std::ranges::lower_bound(size_classes, size);
+  return std::min(static_cast<std::size_t>(it - size_classes.begin()),
+                  size_classes.size() - 1);
+}
+
+static_assert(size_class_of(0) == 0 && size_class_of(64) == 0);
+static_assert(size_class_of(65) == 1 && size_class_of(size_t{1} << 30) == 2);
+
+/*
+ * The median time of a call. Small inputs are run in batches, for the clock
+ * to be precise enough, each call on its own copy of the input (the
+ * operations may change it, like sort does); the copies are made outside of
+ * the timed part.
+ */
+template <typename Input, typename Implementation>
+auto measure(const Implementation &implementation, const Input &input,
+             std::size_t size) -> double {
+  using Result = std::invoke_result_t<const Implementation &, Input &>;
+  using Clock = std::chrono::steady_clock;
+
+  constexpr auto repeats = 5;
+  const auto elements = std::size_t{1} << 16;
+  const auto batch = std::max(elements / std::max(size, std::size_t{1}),
+                              std::size_t{1});
+  auto times = std::vector<double>();
+
+  // the first round warms up the caches and the allocator and isn't counted
+  for (auto round = 0; round <= repeats; ++round) {
+    auto copies = std::vector<Input>(batch, input);
+
+    auto start = Clock::now();
+    for (auto &copy : copies) {
+      if constexpr (std::is_void_v<Result>) {
+        implementation(copy);
+        bench::do_not_optimize(copy);
+      } else {
+        auto result = implementation(copy);
+        bench::do_not_optimize(result);
+      }
+    }
+    auto elapsed = std::chrono::duration<double>(Clock::now() - start);
+
+    if (round > 0) {
+      times.push_back(elapsed.count() / static_cast<double>(batch));
+    }
+  }
+
+  auto median = times.begin() + repeats / 2;
+  std::ranges::nth_element(times, median);
+  return *median;
+}
+
+// the CPU model, and the number of threads the parallel versions get
+inline auto cpu_model() -> std::string {
+  auto model = std::string("unknown CPU");
+  auto cpuinfo = std::ifstream("/proc/cpuinfo");
+  for (auto line = std::string(); std::getline(cpuinfo, line);) {
+    if (line.starts_with("model name")) {
+      auto start = line.find_first_not_of(' ', line.find(':') + 1);
+      if (line.find(':') != std::string::npos && start != std::string::npos) {
+        model = line.substr(start);
+      }
+      break;
+    }
+  }
+  return model + " (" + std::to_string(std::thread::hardware_concurrency()) +
+         " threads)";
+}
+
+inline auto parse_version(std::string_view name) -> Version {
+  auto it = std::ranges::find(all_versions, name, version_name);
+  if (it == all_versions.end()) {
+    throw std::invalid_argument("unknown version " + std::string(name));
+  }
+  return *it;
+}
+
+// "Iterator,Ranges,Simd"
+inline auto join_versions(const auto &versions) -> std::string {
+  auto joined = std::string();
+  for (auto version : versions) {
+    joined += joined.empty() ? "" : ",";
+    joined += version_name(version);
+  }
+  return joined;
+}
+
+inline auto split_versions(std::string_view joined) -> std::vector<Version> {
+  auto versions = std::vector<Version>();
+  for (auto name : joined | std::views::split(',')) {
+    versions.push_back(parse_version(std::string_view(name)));
+  }
+  return versions;
+}
+
+} // namespace autotune_details
+
+/*
+ * The part of an operation the Autotuner deals with, whatever the types of
+ * its input and result.
+ */
+class Tunable {
+public:
+  using Winners = std::array<Version, autotune_details::size_classes.size()>;
+
+  virtual ~Tunable() = default;
+
+  virtual auto name() const -> const std::string & = 0;
+  // the versions with an implementation, in the order they were added
+  virtual auto versions() const -> std::vector<Version> = 0;
+  virtual auto winners() const -> Winners = 0;
+  // throws std::invalid_argument if a winner has no implementation
+  virtual auto set_winners(const Winners &winners) -> void = 0;
+  // the inputs are of the size_classes sizes, capped at max_size
+  virtual auto tune(std::uint64_t seed, std::size_t max_size) -> void = 0;
+};
+
+/*
+ * An operation taking an Input (by reference, so that it can work in place)
+ * and returning a Result. The generator makes the inputs for tuning, and the
+ * size of an input decides its size class; for ranges it's their size by
+ * default.
+ *
+ * Until it's tuned, the operation calls the first implementation added.
+ */
+template <typename Input, typename Result = void>
+class TunedOperation final : public Tunable {
+public:
+  using Generator = std::function<Input(std::size_t, std::mt19937_64 &)>;
+  using SizeOf = std::function<std::size_t(const Input &)>;
+  using Implementation = std::function<Result(Input &)>;
+
+private:
+  std::string name_;
+  Generator generate_;
+  SizeOf size_of_;
+  std::vector<std::pair<Version, Implementation>> implementations_;
+  // indices into implementations_
+  std::array<std::size_t, autotune_details::size_classes.size()> winners_{};
+
+public:
+  TunedOperation(std::string name, Generator generate, SizeOf size_of)
+      : name_(std::move(name)), generate_(std::move(generate)),
+        size_of_(std::move(size_of)) {}
+
+  TunedOperation(std::string name, Generator generate)
+    requires std::ranges::sized_range<const Input>
+      : TunedOperation(std::move(name), std::move(generate),
+                       [](const Input &input) {
+                         return static_cast<std::size_t>(
+                             std::ranges::size(input));
+                       }) {}
+
+  auto add(Version version, Implementation implementation)
+      -> TunedOperation & {
+    if (std::ranges::find(implementations_, version,
+                          &std::pair<Version, Implementation>::first) !=
+        implementations_.end()) {
+      throw std::invalid_argument(name_ + ": version added twice");
+    }
+    implementations_.emplace_back(version, std::move(implementation));
+    return *this;
+  }
+
+  /*
+   * Adds the given versions of a template, like
+   *   op.add<Version::Iterator, Version::Ranges>(
+   *       []<Version version>(Input &input) { return f<version>(input); });
+   */
+  template <Version... version, typename Fn>
+  auto add(Fn fn) -> TunedOperation & {
+    (add(version,
+         [fn](Input &input) -> Result {
+           return fn.template operator()<version>(input);
+         }),
+     ...);
+    return *this;
+  }
+
+  // throws std::logic_error if no version was added, which is a programming
+  // error, but one that release builds still have to notice
+  auto operator()(Input &input) const -> Result {
+    if (implementations_.empty()) {
+      throw std::logic_error(name_ + ": no version added");
+    }
+    auto size_class = autotune_details::size_class_of(size_of_(input));
+    return implementations_[winners_[size_class]].second(input);
+  }
+
+  auto name() const -> const std::string & override { return name_; }
+
+  auto versions() const -> std::vector<Version> override {
+    auto versions = std::vector<Version>();
+    for (const auto &[version, implementation] : implementations_) {
+      versions.push_back(version);
+    }
+    return versions;
+  }
+
+  auto winners() const -> Winners override {
+    if (implementations_.empty()) {
+      throw std::logic_error(name_ + ": no version added");
+    }
+    auto winners = Winners();
+    for (auto c = std::size_t{0}; c < winners.size(); ++c) {
+      winners[c] = implementations_[winners_[c]].first;
+    }
+    return winners;
+  }
+
+  auto set_winners(const Winners &winners) -> void override {
+    auto all = versions();
+    auto indices = winners_;
+    for (auto c = std::size_t{0}; c < winners.size(); ++c) {
+      auto it = std::ranges::find(all, winners[c]);
+      if (it == all.end()) {
+        throw std::invalid_argument(name_ + ": no such version");
+      }
+      indices[c] = static_cast<std::size_t>(it - all.begin());
+    }
+    winners_ = indices;
+  }
+
+  auto tune(std::uint64_t seed, std::size_t max_size) -> void override {
+    using namespace autotune_details;
+
+    for (auto c = std::size_t{0}; c < size_classes.size(); ++c) {
+      auto rng = std::mt19937_64(seed + c);
+      const auto size = std::min(size_classes[c], max_size);
+      const auto input = generate_(size, rng);
+
+      auto best = std::numeric_limits<double>::infinity();
+      for (auto i = std::size_t{0}; i < implementations_.size(); ++i) {
+        auto time = measure(implementations_[i].second, input, size);
+        if (time < best) {
+          best = time;
+          winners_[c] = i;
+        }
+      }
+    }
+  }
+};
+
+/*
+ * The registry. The cache file has a line per CPU model and operation:
+ *
+ *   <CPU model> TAB <operation> TAB <versions> TAB <winners>
+ *
+ * with the versions and the winners (one per size class) as comma-separated
+ * names. A line only applies while the operation has the same versions, so
+ * adding a version to an operation makes it retuned on the next start.
+ */
+class Autotuner {
+  std::vector<std::unique_ptr<Tunable>> operations_;
+
+  struct CacheLine {
+    std::string cpu;
+    std::string operation;
+    std::string versions;
+    std::string winners;
+  };
+
+  static auto read_cache(const std::filesystem::path &path)
+      -> std::vector<CacheLine> {
+    auto lines = std::vector<CacheLine>();
+    auto file = std::ifstream(path);
+    for (auto line = std::string(); std::getline(file, line);) {
+      auto fields = std::vector<std::string>();
+      for (auto field : line | std::views::split('\t')) {
+        fields.emplace_back(std::string_view(field));
+      }
+      // skips the lines of other formats rather than failing
+      if (fields.size() == 4) {
+        lines.push_back({fields[0], fields[1], fields[2], fields[3]});
+      }
+    }
+    return lines;
+  }
+
+public:
+  template <typename Input, typename Result = void, typename... Args>
+  auto add(std::string name, Args &&...args)
+      -> TunedOperation<Input, Result> & {
+    if (find(name) != nullptr) {
+      throw std::invalid_argument("Autotuner: " + name + " added twice");
+    }
+    auto operation = std::make_unique<TunedOperation<Input, Result>>(
+        std::move(name), std::forward<Args>(args)...);
+    auto &added = *operation;
+    operations_.push_back(std::move(operation));
+    return added;
+  }
+
+  auto find(std::string_view name) const -> Tunable * {
+    auto it = std::ranges::find(operations_, name, &Tunable::name);
+    return it == operations_.end() ? nullptr : it->get();
+  }
+
+  // throws std::out_of_range for an unknown name, and std::invalid_argument
+  // if the operation has other input or result types
+  template <typename Input, typename Result = void>
+  auto operation(std::string_view name) const
+      -> TunedOperation<Input, Result> & {
+    auto *found = find(name);
+    if (found == nullptr) {
+      throw std::out_of_range("Autotuner: no operation " + std::string(name));
+    }
+    auto *typed = dynamic_cast<TunedOperation<Input, Result> *>(found);
+    if (typed == nullptr) {
+      throw std::invalid_argument("Autotuner: other types for " +
+                                  std::string(name));
+    }
+    return *typed;
+  }
+
+  auto operations() const {
+    return operations_ | std::views::transform(
+                             [](const auto &operation) -> const Tunable & {
+                               return *operation;
+                             });
+  }
+
+  /*
+   * A max_size below the largest size class makes tuning quick, but the
+   * winners then say little about the large inputs: it's meant for the tests,
+   * to run every generator and version.
+   */
+  auto tune(std::uint64_t seed = 42,
+            std::size_t max_size = std::numeric_limits<std::size_t>::max())
+      -> void {
+    for (auto &operation : operations_) {
+      operation->tune(seed, max_size);
+    }
+  }
+
+  /*
+   * Applies the cached winners for this CPU; returns whether all the
+   * operations got theirs. A missing file is just an empty cache.
+   */
+  auto load(const std::filesystem::path &path) -> bool {
+    using namespace autotune_details;
+
+    const auto cpu = cpu_model();
+    auto loaded = std::size_t{0};
+    for (const auto &line : read_cache(path)) {
+      auto *operation = find(line.operation);
+      if (line.cpu != cpu || operation == nullptr ||
+          line.versions != join_versions(operation->versions())) {
+        continue;
+      }
+      try {
+        auto winners = split_versions(line.winners);
+        auto applied = Tunable::Winners();
+        if (winners.size() != applied.size()) {
+          continue;
+        }
+        std::ranges::copy(winners, applied.begin());
+        operation->set_winners(applied);
+        ++loaded;
+      } catch (const std::invalid_argument &) {
+        // a damaged line, the operation gets tuned again
+      }
+    }
+    return loaded == operations_.size();
+  }
+
+  /*
+   * Replaces the lines of this CPU, keeping the ones of the others, so the
+   * file can be shared (e.g. by a home directory on several machines). The
+   * file is written next to the old one and renamed over it, so a concurrent
+   * reader never sees half of it.
+   */
+  auto save(const std::filesystem::path &path) const -> void {
+    using namespace autotune_details;
+
+    const auto cpu = cpu_model();
+    auto out = std::ostringstream();
+    for (const auto &line : read_cache(path)) {
+      if (line.cpu != cpu) {
+        out << line.cpu << '\t' << line.operation << '\t' << line.versions
+            << '\t' << line.winners << '\n';
+      }
+    }
+    for (const auto &operation : operations_) {
+      out << cpu << '\t' << operation->name() << '\t'
+          << join_versions(operation->versions()) << '\t'
+          << join_versions(operation->winners()) << '\n';
+    }
+
+    // a name of its own, so processes saving at the same time don't write
+    // into the same file; it's removed if anything fails
+    auto temp = TempFile(path.filename().string(), path.parent_path());
+    {
+      auto file = std::ofstream(temp.path(), std::ios::trunc);
+      file << out.str();
+      if (!file.flush()) {
+        throw std::runtime_error("cannot write autotuner cache " +
+                                 temp.path().string());
+      }
+    }
+    std::filesystem::rename(temp.path(), path);
+  }
+
+  auto load_or_tune(const std::filesystem::path &path) -> void {
+    if (!load(path)) {
+      tune();
+      save(path);
+    }
+  }
+};
+
+/*
+ * The operations of this chapter with more than one version. The sizes are
+ * the numbers of elements, of characters for strings_equal (which gets equal
+ * strings, the slowest case), and of both lists together for hash_join.
+ */
+inline auto default_autotuner() -> Autotuner {
+  using TunedBook = Book<std::string>;
+  using Books = std::vector<TunedBook>;
+  using StringPair = std::pair<std::string, std::string>;
+  using Titles = std::vector<std::string>;
+  using TitlesPair = std::pair<Titles, Titles>;
+
+  auto tuner = Autotuner();
+
+  tuner
+      .add<StringPair, bool>(
+          "strings_equal",
+          [](std::size_t size, std::mt19937_64 &rng) {
+            auto str = std::string(size, ' ');
+            std::ranges::generate(
+                str, [&] { return static_cast<char>('a' + rng() % 26); });
+            return StringPair(str, str);
+          },
+          [](const StringPair &input) { return input.first.size(); })
+      .add<Version::Iterator, Version::Ranges, Version::Simd>(
+          []<Version version>(StringPair &input) {
+            return strings_equal<version>(input.first, input.second);
+          });
+
+  tuner
+      .add<std::vector<int>, std::vector<int>>(
+          "doubled_odd_numbers",
+          [](std::size_t size, std::mt19937_64 &rng) {
+            // the doubled numbers have to fit into an int
+            auto number = std::uniform_int_distribution<int>(
+                std::numeric_limits<int>::min() / 2,
+                std::numeric_limits<int>::max() / 2);
+            auto numbers = std::vector<int>(size);
+            std::ranges::generate(numbers, [&] { return number(rng); });
+            return numbers;
+          })
+      .add<Version::Iterator, Version::Ranges>(
+          []<Version version>(std::vector<int> &numbers) {
+            return doubled_odd_numbers<version>(numbers);
+          });
+
+  // half of the titles repeat, for the operations which look for equal ones
+  auto generate_books = [](std::size_t size, std::mt19937_64 &rng) {
+    return random_books(rng(), size, size / 2 + 1);
+  };
+
+  tuner.add<Books>("sort", generate_books)
+      .add<Version::Iterator, Version::Ranges>(
+          []<Version version>(Books &books) { sort<version>(books); });
+
+  tuner.add<Books, std::size_t>("dedupe_by_title", generate_books)
+      .add<Version::Ranges, Version::Parallel>(
+          []<Version version>(Books &books) {
+            return dedupe_by<version>(books, &TunedBook::title);
+          });
+
+  tuner
+      .add<TitlesPair, std::vector<hash_join_match>>(
+          "hash_join",
+          [generate_books](std::size_t size, std::mt19937_64 &rng) {
+            auto titles = TitlesPair();
+            for (const auto &book : generate_books(size, rng)) {
+              auto &side = titles.first.size() < size / 4 ? titles.first
+                                                          : titles.second;
+              side.push_back(book.title);
+            }
+            return titles;
+          },
+          [](const TitlesPair &input) {
+            return input.first.size() + input.second.size();
+          })
+      .add<Version::Ranges, Version::Parallel>(
+          []<Version version>(TitlesPair &input) {
+            return hash_join<version>(input.first, input.second);
+          });
+
+  return tuner;
+}
+
+/*
+ * Runtime-only test: the file and the timing make it unsuitable for
+ * static_assert. Run by ch03-differential.
+ */
+inline void autotuner_test() {
+  using Numbers = std::vector<int>;
+
+  auto tuner = Autotuner();
+  auto &sum = tuner
+                  .add<Numbers, long>("sum",
+                                      [](std::size_t size, std::mt19937_64 &) {
+                                        return Numbers(size, 1);
+                                      })
+                  .add(Version::Iterator,
+                       [](Numbers &numbers) {
+                         return std::accumulate(numbers.begin(),
+                                                numbers.end(), 0L);
+                       })
+                  .add(Version::Ranges, [](Numbers &numbers) {
+                    auto total = 0L;
+                    std::ranges::for_each(numbers, [&](int n) { total += n; });
+                    return total;
+                  });
+
+  auto numbers = Numbers{1, 2, 3};
+  runtime_check(sum(numbers) == 6);
+  runtime_check(sum.winners()[0] == Version::Iterator);
+
+  sum.set_winners({Version::Ranges, Version::Iterator, Version::Ranges});
+  runtime_check(sum(numbers) == 6);
+
+  auto file = TempFile("ch03-autotune-test");
+  const auto &path = file.path();
+  auto loaded = tuner.load(path);
+  runtime_check(!loaded);
+
+  tuner.load_or_tune(path);
+  auto winners = sum.winners();
+
+  // the file was written under a name of its own and renamed
+  const auto prefix = path.filename().string() + "-";
+  for (const auto &entry :
+       std::filesystem::directory_iterator(path.parent_path())) {
+    runtime_check(!entry.path().filename().string().starts_with(prefix));
+  }
+
+  // a fresh registry gets the same winners from the file
+  auto other = Autotuner();
+  auto &other_sum =
+      other.add<Numbers, long>("sum", [](std::size_t, std::mt19937_64 &) {
+        return Numbers();
+      });
+  other_sum.add(Version::Iterator, [](Numbers &) { return 0L; })
+      .add(Version::Ranges, [](Numbers &) { return 0L; });
+  loaded = other.load(path);
+  runtime_check(loaded && other_sum.winners() == winners);
+
+  // but not with other versions
+  other_sum.add(Version::Simd, [](Numbers &) { return 0L; });
+  loaded = other.load(path);
+  runtime_check(!loaded);
+
+  runtime_check(&tuner.operation<Numbers, long>("sum") == &sum);
+
+  // an operation without versions can't be called, even with NDEBUG
+  auto &empty = tuner.add<Numbers, long>(
+      "empty", [](std::size_t size, std::mt19937_64 &) {
+        return Numbers(size);
+      });
+  auto threw = false;
+  try {
+    empty(numbers);
+  } catch (const std::logic_error &) {
+    threw = true;
+  }
+  runtime_check(threw);
+
+  // the operations of the chapter, tuned on small inputs to be quick: the
+  // winners don't mean much, but every generator and version gets to run
+  auto chapter = default_autotuner();
+  chapter.tune(42, 256);
+  for (const auto &operation : chapter.operations()) {
+    const auto versions = operation.versions();
+    for (auto winner : operation.winners()) {
+      runtime_check(std::ranges::find(versions, winner) != versions.end());
+    }
+  }
+
+  using TunedBook = Book<std::string>;
+  auto books = random_books(42, 1000, 100);
+  chapter.operation<std::vector<TunedBook>>("sort")(books);
+  runtime_check(std::ranges::is_sorted(books, {}, &TunedBook::title));
+}
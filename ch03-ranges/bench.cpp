@@ -0,0 +1,99 @@
+/*
+ * Benchmarks of the Version variants of the chapter, see bench/bench.h.
+ *
+ *   ch03-bench [--filter=sort] [--max-size=64K] [--json=ch03.json]
+ *
+ * Build it in Release mode (-DCMAKE_BUILD_TYPE=Release), the numbers of a
+ * debug build say little.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench.h"
+#include "odd_numbers.h"
+#include "random_books.h"
+#include "range.h"
+#include "sort_books.h"
+#include "strings_equal.h"
+#include "version.h"
+
+namespace {
+
+using BenchBook = Book<std::string>;
+
+auto random_numbers(std::size_t size) -> std::vector<int> {
+  auto rng = std::mt19937_64(size);
+  auto numbers = std::vector<int>(size);
+  std::ranges::generate(numbers,
+                        [&] { return static_cast<int>(rng() % 1000); });
+  return numbers;
+}
+
+auto random_string(std::size_t size, std::mt19937_64 &rng) -> std::string {
+  auto str = std::string(size, ' ');
+  std::ranges::generate(
+      str, [&] { return static_cast<char>('a' + rng() % 26); });
+  return str;
+}
+
+auto registry() -> bench::Registry {
+  auto registry = bench::Registry();
+
+  registry.add<Version::Iterator, Version::Ranges>(
+      "doubled_odd_numbers", {1'000, 100'000, 1'000'000}, version_name,
+      []<Version version>(std::size_t size) -> bench::Case {
+        return {[numbers = random_numbers(size)] {
+          auto doubled = doubled_odd_numbers<version>(numbers);
+          bench::do_not_optimize(doubled);
+        }};
+      });
+
+  // equal strings, the slowest case: every byte has to be compared
+  registry.add<Version::Iterator, Version::Ranges, Version::Simd>(
+      "strings_equal", {16, 256, 4'096, 65'536}, version_name,
+      []<Version version>(std::size_t size) -> bench::Case {
+        auto rng = std::mt19937_64(size);
+        auto lhs = random_string(size, rng);
+        return {[lhs, rhs = lhs] {
+          auto equal = strings_equal<version>(lhs, rhs);
+          bench::do_not_optimize(equal);
+        }};
+      });
+
+  registry.add<Version::Iterator, Version::Ranges>(
+      "sort", {1'000, 10'000, 100'000}, version_name,
+      []<Version version>(std::size_t size) -> bench::Case {
+        auto input = random_books(size, size);
+        auto books = std::make_shared<std::vector<BenchBook>>();
+        return {[books] {
+                  sort<version>(*books);
+                  bench::do_not_optimize(*books);
+                },
+                [books, input] { *books = input; }};
+      });
+
+  // sum_while_greater has a single, ranges-based, implementation; the
+  // numbers are all above the limit, so the whole input is summed
+  registry.add<Version::Ranges>(
+      "sum_while_greater", {1'000, 100'000, 1'000'000}, version_name,
+      []<Version>(std::size_t size) -> bench::Case {
+        return {[numbers = std::vector<int>(size, 1)] {
+          auto sum = sum_while_greater<0>(numbers);
+          bench::do_not_optimize(sum);
+        }};
+      });
+
+  return registry;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  return bench::main(argc, argv, registry());
+}
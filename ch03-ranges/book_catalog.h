@@ -0,0 +1,213 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "sort_books.h"
+
+/*
+ * A bump allocator for string bytes. Memory is requested in big chunks, and
+ * every new string just takes the next free bytes of the current chunk. Strings
+ * are never freed one by one: the whole arena is released at once.
+ *
+ * Chunks are never reallocated, so string_views into the arena stay valid
+ * for the lifetime of the arena (including moves of the arena itself).
+ *
+ * We use std::allocator directly rather than new[] or unique_ptr<char[]>, as
+ * std::allocator is usable at compile time since C++20. This way the arena can
+ * be tested in consteval functions, just like everything else here.
+ */
+class StringArena {
+  struct Chunk {
+    char *data;
+    std::size_t size;
+  };
+
+  std::vector<Chunk> chunks_;
+  std::size_t chunk_size_;
+  // free space in the last chunk
+  char *cursor_ = nullptr;
+  std::size_t left_ = 0;
+
+public:
+  constexpr static std::size_t default_chunk_size = 1 << 20;
+
+  constexpr explicit StringArena(std::size_t chunk_size = default_chunk_size)
+      : chunk_size_(chunk_size) {}
+
+  // copying would leave the views of the copy pointing into the original
+  StringArena(const StringArena &) = delete;
+  StringArena &operator=(const StringArena &) = delete;
+
+  constexpr StringArena(StringArena &&other) noexcept
+      : chunks_(std::exchange(other.chunks_, {})),
+        chunk_size_(other.chunk_size_),
+        cursor_(std::exchange(other.cursor_, nullptr)),
+        left_(std::exchange(other.left_, 0)) {}
+
+  constexpr StringArena &operator=(StringArena &&other) noexcept {
+    if (this != &other) {
+      release();
+      chunks_ = std::exchange(other.chunks_, {});
+      chunk_size_ = other.chunk_size_;
+      cursor_ = std::exchange(other.cursor_, nullptr);
+      left_ = std::exchange(other.left_, 0);
+    }
+    return *this;
+  }
+
+  constexpr ~StringArena() { release(); }
+
+  /*
+   * Copies the string into the arena and returns a view to the copy.
+   */
+  constexpr auto store(std::string_view str) -> std::string_view {
+    if (str.size() > left_) {
+      // strings longer than a chunk get a chunk of their own
+      grow(std::max(chunk_size_, str.size()));
+    }
+
+    auto *dest = cursor_;
+    std::ranges::copy(str, dest);
+    cursor_ += str.size();
+    left_ -= str.size();
+
+    return {dest, str.size()};
+  }
+
+  // the cost depends on the number of chunks only, not on the number of strings
+  constexpr auto release() -> void {
+    auto alloc = std::allocator<char>();
+    for (auto [data, size] : chunks_) {
+      alloc.deallocate(data, size);
+    }
+    chunks_.clear();
+    cursor_ = nullptr;
+    left_ = 0;
+  }
+
+  constexpr auto chunk_count() const -> std::size_t { return chunks_.size(); }
+
+private:
+  constexpr auto grow(std::size_t size) -> void {
+    auto *data = std::allocator<char>().allocate(size);
+    chunks_.push_back({data, size});
+    cursor_ = data;
+    left_ = size;
+  }
+};
+
+/*
+ * Book catalog that keeps all the title and isbn bytes in a single arena.
+ *
+ * Book<std::string> costs two separate allocations per book, and the strings
+ * end up scattered all over the heap. Here, the rows are Book<std::string_view>
+ * (Book supports that thanks to StringConcept), pointing into the arena. So
+ * loading N books takes N / chunk_size arena allocations plus the rows vector,
+ * and the strings of neighbouring books are neighbours in memory as well.
+ *
+ * The catalog is a range of books itself, so it satisfies BooksConcept and
+ * can be sorted with sort<version> directly (only the views are swapped then).
+ */
+class BookCatalog {
+public:
+  using BookType = Book<std::string_view>;
+
+private:
+  StringArena arena_;
+  std::vector<BookType> books_;
+
+public:
+  constexpr explicit BookCatalog(
+      std::size_t chunk_size = StringArena::default_chunk_size)
+      : arena_(chunk_size) {}
+
+  constexpr explicit BookCatalog(const BooksConcept auto &books,
+                                 std::size_t chunk_size =
+                                     StringArena::default_chunk_size)
+      : arena_(chunk_size) {
+    if constexpr (std::ranges::sized_range<decltype(books)>) {
+      reserve(std::ranges::size(books));
+    }
+    for (const auto &book : books) {
+      add(book.title, book.isbn);
+    }
+  }
+
+  constexpr auto reserve(std::size_t count) -> void { books_.reserve(count); }
+
+  constexpr auto add(std::string_view title, std::string_view isbn)
+      -> const BookType & {
+    return books_.emplace_back(arena_.store(title), arena_.store(isbn));
+  }
+
+  // drops all the books and releases the arena in one go
+  constexpr auto clear() -> void {
+    books_.clear();
+    arena_.release();
+  }
+
+  constexpr auto size() const -> std::size_t { return books_.size(); }
+  constexpr auto empty() const -> bool { return books_.empty(); }
+
+  constexpr auto operator[](std::size_t i) -> BookType & { return books_[i]; }
+  constexpr auto operator[](std::size_t i) const -> const BookType & {
+    return books_[i];
+  }
+
+  constexpr auto begin() { return books_.begin(); }
+  constexpr auto end() { return books_.end(); }
+  constexpr auto begin() const { return books_.begin(); }
+  constexpr auto end() const { return books_.end(); }
+};
+
+static_assert(BooksConcept<BookCatalog>);
+static_assert(std::ranges::random_access_range<BookCatalog>);
+
+/*
+ * Compile-time tests
+ */
+namespace book_catalog_test {
+
+consteval auto test_arena() -> bool {
+  // tiny chunks to make the arena grow
+  auto arena = StringArena(8);
+
+  auto a = arena.store("abcde");
+  auto b = arena.store("fgh");
+  auto c = arena.store("a string longer than a chunk");
+
+  return a == "abcde" && b == "fgh" && c == "a string longer than a chunk" &&
+         arena.chunk_count() == 2;
+}
+
+consteval auto test_catalog() -> bool {
+  using Book = Book<std::string_view>;
+
+  auto input = std::to_array<Book>({
+      {"Functional programming in C++", "978-3-20-148410-0"},
+      {"Effective C++", "978-3-16-148410-0"},
+  });
+  auto expected = std::to_array<Book>({
+      {"Effective C++", "978-3-16-148410-0"},
+      {"Functional programming in C++", "978-3-20-148410-0"},
+  });
+
+  auto catalog = BookCatalog(input, 16);
+  sort<Version::Ranges>(catalog);
+
+  // the catalog keeps working after being moved
+  auto moved = std::move(catalog);
+
+  return std::ranges::equal(moved, expected) &&
+         moved[0].title.data() != expected[0].title.data();
+}
+
+static_assert(test_arena());
+static_assert(test_catalog());
+
+} // namespace book_catalog_test
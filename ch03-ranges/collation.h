@@ -0,0 +1,341 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "argsort.h"
+#include "book_catalog.h"
+#include "sort_books.h"
+
+/*
+ * Case- and accent-insensitive sorting with precomputed collation keys.
+ *
+ * Comparing "Éclair" and "eclair" the way people expect requires decoding
+ * UTF-8, folding the case and stripping the accents. Doing that inside the
+ * comparator of a sort would repeat the work O(n log n) times. Instead, like
+ * strxfrm does, we transform every title once into a key, such that comparing
+ * the keys byte by byte (memcmp) gives the collation order.
+ *
+ * The key has up to three levels separated by a 0 byte, like the Unicode
+ * Collation Algorithm:
+ * - primary: the base letters (case and accents folded), digits and other
+ *   characters,
+ * - secondary: the accents,
+ * - tertiary: the case.
+ * The lower levels only matter when all the higher levels are equal, so with
+ * the Primary strength "eclair" == "Eclair" == "Éclair", with the Secondary
+ * strength "eclair" == "Eclair" < "Éclair", and with the Tertiary strength
+ * "eclair" < "Eclair" < "Éclair".
+ *
+ * The base letters and accents are known for the Latin-1 range; other code
+ * points are ordered after all the Latin letters, by their value.
+ */
+enum class CollationStrength { Primary, Secondary, Tertiary };
+
+namespace collation_details {
+
+enum class Accent : std::uint8_t {
+  None,
+  Grave,
+  Acute,
+  Circumflex,
+  Tilde,
+  Diaeresis,
+  Ring,
+  Cedilla,
+  Stroke,
+};
+
+struct Latin1Letter {
+  // upper case base letters, empty for non-letters; Æ, Þ and ß expand to two
+  std::string_view base;
+  Accent accent;
+};
+
+// U+00C0 - U+00DF, the lower case letters are at +0x20 (except for ß and ÿ)
+constexpr auto latin1_letters = std::to_array<Latin1Letter>({
+    {"A", Accent::Grave}, // À
+    {"A", Accent::Acute}, // Á
+    {"A", Accent::Circumflex}, // Â
+    {"A", Accent::Tilde}, // Ã
+    {"A", Accent::Diaeresis}, // Ä
+    {"A", Accent::Ring}, // Å
+    {"AE", Accent::None}, // Æ
+    {"C", Accent::Cedilla}, // Ç
+    {"E", Accent::Grave}, // È
+    {"E", Accent::Acute}, // É
+    {"E", Accent::Circumflex}, // Ê
+    {"E", Accent::Diaeresis}, // Ë
+    {"I", Accent::Grave}, // Ì
+    {"I", Accent::Acute}, // Í
+    {"I", Accent::Circumflex}, // Î
+    {"I", Accent::Diaeresis}, // Ï
+    {"D", Accent::Stroke}, // Ð
+    {"N", Accent::Tilde}, // Ñ
+    {"O", Accent::Grave}, // Ò
+    {"O", Accent::Acute}, // Ó
+    {"O", Accent::Circumflex}, // Ô
+    {"O", Accent::Tilde}, // Õ
+    {"O", Accent::Diaeresis}, // Ö
+    {"", Accent::None}, // ×
+    {"O", Accent::Stroke}, // Ø
+    {"U", Accent::Grave}, // Ù
+    {"U", Accent::Acute}, // Ú
+    {"U", Accent::Circumflex}, // Û
+    {"U", Accent::Diaeresis}, // Ü
+    {"Y", Accent::Acute}, // Ý
+    {"TH", Accent::None}, // Þ
+    {"SS", Accent::None}, // ß, lower case
+});
+
+/*
+ * Decodes the next code point; invalid bytes are mapped to the U+DC80 - U+DCFF
+ * range (like Python's surrogateescape), so every input has a key.
+ */
+constexpr auto decode_utf8(std::string_view text, std::size_t &pos)
+    -> char32_t {
+  auto byte = [&](std::size_t i) {
+    return static_cast<unsigned char>(text[i]);
+  };
+  auto is_continuation = [&](std::size_t i) {
+    return i < text.size() && (byte(i) & 0xC0) == 0x80;
+  };
+
+  const auto lead = byte(pos);
+  const auto length = lead < 0x80   ? 1
+                      : lead < 0xC2 ? 0
+                      : lead < 0xE0 ? 2
+                      : lead < 0xF0 ? 3
+                      : lead < 0xF5 ? 4
+                                    : 0;
+
+  auto valid = length > 0;
+  for (auto i = 1; valid && i < length; ++i) {
+    valid = is_continuation(pos + i);
+  }
+  if (!valid) {
+    ++pos;
+    return 0xDC00 + lead;
+  }
+
+  auto cp = static_cast<char32_t>(length == 1 ? lead
+                                  : length == 2 ? lead & 0x1F
+                                  : length == 3 ? lead & 0x0F
+                                                : lead & 0x07);
+  for (auto i = 1; i < length; ++i) {
+    cp = (cp << 6) | (byte(pos + i) & 0x3F);
+  }
+  pos += length;
+  return cp;
+}
+
+// level weights start from 5, to keep 0 free for the separator
+constexpr char level_base = 5;
+constexpr char separator = 0;
+
+} // namespace collation_details
+
+/*
+ * Builds collation keys into an internal buffer, which is reused from key to
+ * key, so building keys doesn't allocate once the buffers have grown.
+ */
+class CollationKeyBuilder {
+  CollationStrength strength_;
+  std::vector<char> key_;
+  std::vector<char> secondary_;
+  std::vector<char> tertiary_;
+
+public:
+  constexpr explicit CollationKeyBuilder(
+      CollationStrength strength = CollationStrength::Tertiary)
+      : strength_(strength) {}
+
+  // the view is valid until the next call
+  constexpr auto build(std::string_view text) -> std::string_view {
+    using namespace collation_details;
+
+    key_.clear();
+    secondary_.clear();
+    tertiary_.clear();
+
+    for (auto pos = std::size_t{0}; pos < text.size();) {
+      auto cp = decode_utf8(text, pos);
+
+      if (cp >= 'a' && cp <= 'z') {
+        letter(static_cast<char>(cp - 'a' + 'A'), Accent::None, false);
+      } else if (cp >= 'A' && cp <= 'Z') {
+        letter(static_cast<char>(cp), Accent::None, true);
+      } else if (cp >= '0' && cp <= '9') {
+        // digits go before letters
+        unit({static_cast<char>(0x10 + (cp - '0'))});
+      } else if (cp < 0x80) {
+        // spaces and punctuation go before digits, in ASCII order
+        unit({0x01, static_cast<char>(cp + 1)});
+      } else if (cp >= 0xC0 && cp <= 0xFF && cp != 0xD7 && cp != 0xF7) {
+        auto upper = cp < 0xE0;
+        const auto &[base, accent] =
+            cp == 0xFF ? Latin1Letter{"Y", Accent::Diaeresis}
+                       : latin1_letters[(cp - 0xC0) % 0x20];
+        for (auto c : base) {
+          letter(c, accent, upper && cp != 0xDF);
+        }
+      } else {
+        // everything else goes after the letters, by the code point, encoded
+        // in 7-bit groups, so that there are no 0 bytes
+        unit({static_cast<char>(0x70),
+              static_cast<char>(((cp >> 14) & 0x7F) + 1),
+              static_cast<char>(((cp >> 7) & 0x7F) + 1),
+              static_cast<char>((cp & 0x7F) + 1)});
+      }
+    }
+
+    if (strength_ != CollationStrength::Primary) {
+      key_.push_back(separator);
+      key_.insert(key_.end(), secondary_.begin(), secondary_.end());
+    }
+    if (strength_ == CollationStrength::Tertiary) {
+      key_.push_back(separator);
+      key_.insert(key_.end(), tertiary_.begin(), tertiary_.end());
+    }
+
+    return {key_.data(), key_.size()};
+  }
+
+private:
+  constexpr auto letter(char upper_base, collation_details::Accent accent,
+                        bool upper) -> void {
+    using namespace collation_details;
+    key_.push_back(static_cast<char>(0x20 + (upper_base - 'A')));
+    secondary_.push_back(
+        static_cast<char>(level_base + static_cast<char>(accent)));
+    tertiary_.push_back(static_cast<char>(level_base + (upper ? 1 : 0)));
+  }
+
+  constexpr auto unit(std::initializer_list<char> primary) -> void {
+    using namespace collation_details;
+    key_.insert(key_.end(), primary);
+    secondary_.push_back(level_base);
+    tertiary_.push_back(level_base);
+  }
+};
+
+/*
+ * Sorts the books by the collation keys of their titles.
+ *
+ * The keys are built once per book and stored in an arena (see
+ * book_catalog.h), so building them doesn't allocate per book either. Next to
+ * every key, we store its first 8 bytes as a big-endian integer: most of the
+ * comparisons are decided by a single integer compare, and only the ties fall
+ * back to memcmp over the whole keys.
+ *
+ * Only the small sort records move during the sort; the books themselves are
+ * moved once, at the end (see apply_permutation in argsort.h).
+ */
+constexpr auto sort_collated(BooksConcept auto &books,
+                             CollationStrength strength =
+                                 CollationStrength::Tertiary) -> void {
+  struct Record {
+    std::uint64_t prefix;
+    std::string_view key;
+    std::uint32_t index;
+  };
+
+  auto builder = CollationKeyBuilder(strength);
+  auto arena = StringArena();
+  auto records = std::vector<Record>();
+  if constexpr (std::ranges::sized_range<decltype(books)>) {
+    records.reserve(std::ranges::size(books));
+  }
+
+  auto index = std::uint32_t{0};
+  for (const auto &book : books) {
+    auto key = arena.store(builder.build(book.title));
+
+    auto prefix = std::uint64_t{0};
+    for (auto i = std::size_t{0}; i < 8; ++i) {
+      auto c = i < key.size() ? static_cast<unsigned char>(key[i]) : 0;
+      prefix = (prefix << 8) | c;
+    }
+
+    records.push_back({prefix, key, index++});
+  }
+
+  // equal keys keep the original order, so the result is deterministic
+  std::ranges::sort(records, [](const Record &lhs, const Record &rhs) {
+    if (lhs.prefix != rhs.prefix) {
+      return lhs.prefix < rhs.prefix;
+    }
+    if (auto cmp = lhs.key.compare(rhs.key); cmp != 0) {
+      return cmp < 0;
+    }
+    return lhs.index < rhs.index;
+  });
+
+  auto perm = std::vector<std::uint32_t>(records.size());
+  std::ranges::transform(records, perm.begin(), &Record::index);
+  apply_permutation(books, std::move(perm));
+}
+
+/*
+ * Compile-time tests
+ */
+namespace collation_test {
+
+template <CollationStrength strength>
+consteval auto less(std::string_view lhs, std::string_view rhs) -> bool {
+  auto lhs_builder = CollationKeyBuilder(strength);
+  auto rhs_builder = CollationKeyBuilder(strength);
+  return lhs_builder.build(lhs) < rhs_builder.build(rhs);
+}
+
+template <CollationStrength strength>
+consteval auto equal(std::string_view lhs, std::string_view rhs) -> bool {
+  return !less<strength>(lhs, rhs) && !less<strength>(rhs, lhs);
+}
+
+using enum CollationStrength;
+
+// case and accents are ignored at the primary level
+static_assert(equal<Primary>("Éclair", "eclair"));
+static_assert(equal<Primary>("STRASSE", "Straße"));
+static_assert(less<Primary>("apple", "Banana"));
+static_assert(less<Primary>("Ärger", "Bär"));
+static_assert(less<Primary>("Cafe", "café au lait"));
+
+// accents decide at the secondary level, case is still ignored
+static_assert(less<Secondary>("eclair", "Éclair"));
+static_assert(equal<Secondary>("eclair", "ECLAIR"));
+
+// case decides at the tertiary level
+static_assert(less<Tertiary>("eclair", "Eclair"));
+static_assert(less<Tertiary>("Eclair", "éclair"));
+
+// non-letters
+static_assert(less<Tertiary>(" ", "0"));
+static_assert(less<Tertiary>("9", "a"));
+static_assert(less<Tertiary>("z", "Ω"));
+static_assert(less<Tertiary>("z", "\xff"));
+
+consteval auto test_sort() -> bool {
+  using Book = Book<std::string_view>;
+
+  auto books = std::to_array<Book>({
+      {"éclair", "4"},
+      {"Zebra", "6"},
+      {"Eclair", "3"},
+      {"apple", "1"},
+      {"Éclair", "5"},
+      {"eclair", "2"},
+  });
+  sort_collated(books);
+
+  return std::ranges::equal(books, std::array{"1", "2", "3", "4", "5", "6"},
+                            {}, &Book::isbn);
+}
+
+static_assert(test_sort());
+
+} // namespace collation_test
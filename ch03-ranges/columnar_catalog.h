@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <ranges>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "argsort.h"
+#include "sort_books.h"
+
+/*
+ * A book catalog stored column by column (struct of arrays) rather than book
+ * by book (array of structs): all the titles in one vector, all the isbns in
+ * another, and the i-th book is the i-th element of both.
+ *
+ * With a vector<Book>, scanning the titles also drags the isbns through the
+ * cache, as they sit in between. Here a title scan reads the title column
+ * only, and so does sorting by title: we sort the row indices by the title
+ * column (see argsort.h), and only then permute every column once. A column of
+ * one type is also a natural unit for compression (e.g. front coding of the
+ * sorted titles, or packed isbns), which doesn't work with interleaved
+ * fields.
+ *
+ * The rows are still available as books, through lightweight references.
+ */
+template <StringConcept String, std::regular IsbnType = String>
+struct BookRef {
+  using str_type = String;
+  using isbn_type = IsbnType;
+
+  const String &title;
+  const IsbnType &isbn;
+
+  // a copy of the row as a real Book
+  constexpr operator Book<String, IsbnType>() const { return {title, isbn}; }
+
+  friend constexpr auto operator==(const BookRef &lhs,
+                                   const BookConcept auto &rhs) -> bool {
+    return lhs.title == rhs.title && lhs.isbn == rhs.isbn;
+  }
+  friend constexpr auto operator==(const BookRef &lhs, const BookRef &rhs)
+      -> bool {
+    return lhs.title == rhs.title && lhs.isbn == rhs.isbn;
+  }
+};
+
+template <StringConcept String, std::regular IsbnType = String>
+class ColumnarCatalog {
+  std::vector<String> titles_;
+  std::vector<IsbnType> isbns_;
+
+  // returns the row i of the catalog; a function object rather than a lambda,
+  // so that the row views are default constructible and assignable
+  struct Row {
+    const ColumnarCatalog *catalog;
+    constexpr auto operator()(std::size_t i) const
+        -> BookRef<String, IsbnType> {
+      return (*catalog)[i];
+    }
+  };
+
+  constexpr auto permute(std::vector<std::uint32_t> perm) -> void {
+    apply_permutation(titles_, perm);
+    apply_permutation(isbns_, std::move(perm));
+  }
+
+public:
+  using book_type = Book<String, IsbnType>;
+
+  ColumnarCatalog() = default;
+
+  constexpr explicit ColumnarCatalog(const BooksConcept auto &books) {
+    if constexpr (std::ranges::sized_range<decltype(books)>) {
+      reserve(std::ranges::size(books));
+    }
+    for (const auto &book : books) {
+      push_back(book);
+    }
+  }
+
+  constexpr auto push_back(const BookConcept auto &book) -> void {
+    titles_.push_back(book.title);
+    isbns_.push_back(book.isbn);
+  }
+
+  constexpr auto reserve(std::size_t size) -> void {
+    titles_.reserve(size);
+    isbns_.reserve(size);
+  }
+
+  constexpr auto clear() -> void {
+    titles_.clear();
+    isbns_.clear();
+  }
+
+  constexpr auto size() const -> std::size_t { return titles_.size(); }
+  constexpr auto empty() const -> bool { return titles_.empty(); }
+
+  /*
+   * The columns, for scans which need a single field.
+   */
+  constexpr auto titles() const -> std::span<const String> { return titles_; }
+  constexpr auto isbns() const -> std::span<const IsbnType> { return isbns_; }
+
+  constexpr auto operator[](std::size_t i) const -> BookRef<String, IsbnType> {
+    return {titles_[i], isbns_[i]};
+  }
+
+  /*
+   * A random access view of the rows. The references point into the columns,
+   * so they're invalidated by any change of the catalog, like vector
+   * iterators are.
+   */
+  constexpr auto rows() const {
+    return std::views::iota(std::size_t{0}, size()) |
+           std::views::transform(Row{this});
+  }
+
+  /*
+   * Sorting touches the key column only; the other one is just permuted at the
+   * end. Both sorts are stable.
+   */
+  constexpr auto sort_by_title() -> void { permute(argsort(titles_)); }
+  constexpr auto sort_by_isbn() -> void { permute(argsort(isbns_)); }
+};
+
+/*
+ * Compile-time tests
+ */
+namespace columnar_catalog_test {
+
+using Book = Book<std::string_view>;
+
+constexpr auto books = std::to_array<Book>({
+    {"Functional programming in C++", "978-3-20-148410-0"},
+    {"Effective C++", "978-3-16-148410-0"},
+    {"C++ Concurrency in Action", "978-1-61-729469-3"},
+});
+
+static_assert(std::ranges::random_access_range<
+              decltype(ColumnarCatalog<std::string_view>().rows())>);
+
+consteval auto test_sort() -> bool {
+  auto catalog = ColumnarCatalog<std::string_view>(books);
+  catalog.sort_by_title();
+
+  auto by_title = std::ranges::equal(
+      catalog.titles(),
+      std::array<std::string_view, 3>{"C++ Concurrency in Action",
+                                      "Effective C++",
+                                      "Functional programming in C++"});
+  auto rows_follow = catalog[0] == books[2] && catalog[1] == books[1] &&
+                     catalog[2] == books[0];
+
+  catalog.sort_by_isbn();
+  auto by_isbn = std::ranges::equal(catalog.rows(),
+                                    std::array{books[2], books[1], books[0]});
+
+  return by_title && rows_follow && by_isbn;
+}
+
+consteval auto test_rows() -> bool {
+  auto catalog = ColumnarCatalog<std::string_view>(books);
+
+  // rows convert to books, and back again
+  auto copy = std::vector<Book>();
+  for (Book book : catalog.rows()) {
+    copy.push_back(book);
+  }
+
+  return std::ranges::equal(copy, books) &&
+         ColumnarCatalog<std::string_view>(copy).size() == books.size() &&
+         catalog.rows()[1].title == "Effective C++";
+}
+
+static_assert(test_sort());
+static_assert(test_rows());
+
+} // namespace columnar_catalog_test
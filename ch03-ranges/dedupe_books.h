@@ -0,0 +1,287 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <ranges>
+#include <stdexcept>
+#include <vector>
+
+#include "parallel.h"
+#include "sort_books.h"
+#include "string_hash.h"
+#include "version.h"
+
+/*
+ * Removing books with duplicate keys (e.g. ISBNs) from a catalog.
+ *
+ * Sorting and then std::unique costs O(n log n) and loses the original order.
+ * Here we remember the keys seen so far in a hash set instead, which costs
+ * expected O(n), and then compact the catalog, keeping the survivors in their
+ * original order (or not, if the order doesn't matter, see DedupeOrder).
+ *
+ * Books are duplicates when their projections (e.g. &Book::isbn) are equal.
+ * Like std::erase_if, the functions erase the duplicates from the container
+ * and return how many books were removed.
+ *
+ * The hash sets store 32-bit indices, like argsort (see argsort.h), so the
+ * functions throw std::length_error for more than 2^32 - 1 books.
+ */
+enum class DedupeKeep { First, Last };
+
+enum class DedupeOrder {
+  // the survivors keep their relative order: every survivor is moved
+  Stable,
+  // the holes are filled with the books from the end: only as many books are
+  // moved as there were duplicates
+  Unstable,
+};
+
+template <typename T>
+concept ErasableBooksConcept =
+    BooksConcept<T> && std::ranges::random_access_range<T> &&
+    requires(T &books) { books.erase(books.begin(), books.end()); };
+
+namespace dedupe_details {
+
+constexpr auto check_size(std::size_t size) -> void {
+  if (size > std::numeric_limits<std::uint32_t>::max()) {
+    throw std::length_error("dedupe_by: too many books for 32-bit indices");
+  }
+}
+
+/*
+ * Open addressing hash set of book indices with linear probing: the keys
+ * themselves stay in the books, the table only stores the indices, along with
+ * the upper half of the hashes. Those are compared first, so the keys are
+ * only compared on (almost certain) matches.
+ *
+ * The table is kept at most half full, and its size is a power of two, so that
+ * the slot is just the lower bits of the hash.
+ */
+class IndexSet {
+  struct Slot {
+    std::uint32_t tag;
+    std::uint32_t index;
+  };
+
+  constexpr static auto empty = ~std::uint32_t{0};
+
+  std::vector<Slot> slots_;
+  std::size_t mask_;
+
+public:
+  constexpr explicit IndexSet(std::size_t count)
+      : slots_(std::bit_ceil(std::max(count * 2, std::size_t{16})),
+               Slot{0, empty}),
+        mask_(slots_.size() - 1) {}
+
+  /*
+   * Returns the slot of the index with an equal key, inserting the index if
+   * there is none (then the returned slot contains the index itself).
+   */
+  template <typename Equal>
+  constexpr auto insert(std::uint64_t hash, std::uint32_t index, Equal equal)
+      -> std::uint32_t & {
+    const auto tag = static_cast<std::uint32_t>(hash >> 32);
+    for (auto pos = hash & mask_;; pos = (pos + 1) & mask_) {
+      auto &slot = slots_[pos];
+      if (slot.index == empty) {
+        slot = {tag, index};
+        return slot.index;
+      }
+      if (slot.tag == tag && equal(slot.index, index)) {
+        return slot.index;
+      }
+    }
+  }
+};
+
+/*
+ * Marks the survivors among the given indices (ascending), which all have to
+ * be in the same set.
+ */
+template <typename Books, typename Proj, typename Indices>
+constexpr auto mark(const Books &books, Proj &proj,
+                    const std::vector<std::uint64_t> &hashes,
+                    const Indices &indices, DedupeKeep keep,
+                    std::vector<std::uint8_t> &survivors) -> void {
+  auto first = std::ranges::begin(books);
+  auto equal = [&](std::uint32_t lhs, std::uint32_t rhs) {
+    return std::invoke(proj, first[lhs]) == std::invoke(proj, first[rhs]);
+  };
+
+  auto set = IndexSet(std::ranges::size(indices));
+  for (auto index : indices) {
+    auto &stored = set.insert(hashes[index], index, equal);
+    if (stored == index) {
+      survivors[index] = 1;
+    } else if (keep == DedupeKeep::Last) {
+      survivors[stored] = 0;
+      survivors[index] = 1;
+      stored = index;
+    }
+  }
+}
+
+template <typename Books>
+constexpr auto compact(Books &books, const std::vector<std::uint8_t> &survivors,
+                       DedupeOrder order) -> std::size_t {
+  const auto size = survivors.size();
+  auto first = std::ranges::begin(books);
+  auto out = std::size_t{0};
+
+  if (order == DedupeOrder::Stable) {
+    for (auto i = std::size_t{0}; i < size; ++i) {
+      if (survivors[i]) {
+        if (out != i) {
+          first[out] = std::move(first[i]);
+        }
+        ++out;
+      }
+    }
+  } else {
+    // fill the holes from the front with the survivors from the back
+    auto last = size;
+    while (true) {
+      while (out < last && survivors[out]) {
+        ++out;
+      }
+      while (last > out && !survivors[last - 1]) {
+        --last;
+      }
+      if (out >= last) {
+        break;
+      }
+      first[out++] = std::move(first[--last]);
+    }
+  }
+
+  books.erase(first + out, first + size);
+  return size - out;
+}
+
+} // namespace dedupe_details
+
+template <Version version, ErasableBooksConcept Books, typename Proj,
+          typename Hash = key_hash>
+  requires VersionRanges<version>
+constexpr auto dedupe_by(Books &books, Proj proj,
+                         DedupeKeep keep = DedupeKeep::First,
+                         DedupeOrder order = DedupeOrder::Stable,
+                         Hash hash = {}) -> std::size_t {
+  using namespace dedupe_details;
+
+  const auto size = static_cast<std::size_t>(std::ranges::size(books));
+  check_size(size);
+
+  auto hashes = std::vector<std::uint64_t>(size);
+  for (auto i = std::size_t{0}; i < size; ++i) {
+    hashes[i] = hash(std::invoke(proj, std::ranges::begin(books)[i]));
+  }
+
+  auto survivors = std::vector<std::uint8_t>(size);
+  mark(books, proj, hashes,
+       std::views::iota(std::uint32_t{0}, static_cast<std::uint32_t>(size)),
+       keep, survivors);
+
+  return compact(books, survivors, order);
+}
+
+/*
+ * The parallel version partitions the books by their hashes, so that equal
+ * keys always end up in the same partition, and then deduplicates the
+ * partitions independently, each on its own thread with its own hash set:
+ * 1. every thread hashes a chunk of the books,
+ * 2. the indices of the books are grouped by partitions (see
+ *    parallel_partition), and stay ascending within every partition,
+ * 3. every partition is deduplicated,
+ * 4. the survivors are compacted.
+ *
+ * The partition is taken from the upper bits of the hash, while the hash sets
+ * use the lower bits for the slots.
+ */
+template <Version version, ErasableBooksConcept Books, typename Proj,
+          typename Hash = key_hash>
+  requires VersionParallel<version>
+auto dedupe_by(Books &books, Proj proj, DedupeKeep keep = DedupeKeep::First,
+               DedupeOrder order = DedupeOrder::Stable, Hash hash = {})
+    -> std::size_t {
+  using namespace dedupe_details;
+
+  const auto size = static_cast<std::size_t>(std::ranges::size(books));
+  check_size(size);
+
+  const auto parts = chunk_count(size);
+  if (parts == 1) {
+    return dedupe_by<Version::Ranges>(books, proj, keep, order, hash);
+  }
+
+  // 1.
+  auto hashes = std::vector<std::uint64_t>(size);
+  parallel_chunks(size, parts,
+                  [&](std::size_t, std::size_t first, std::size_t last) {
+                    auto begin = std::ranges::begin(books);
+                    for (auto i = first; i < last; ++i) {
+                      hashes[i] = hash(std::invoke(proj, begin[i]));
+                    }
+                  });
+
+  // 2.
+  auto partitions =
+      parallel_partition(size, parts, parts, [&](std::size_t i) {
+        return (hashes[i] >> 40) % parts;
+      });
+
+  // 3. the threads write to distinct bytes of survivors, which is safe
+  auto survivors = std::vector<std::uint8_t>(size);
+  parallel_chunks(parts, parts, [&](std::size_t p, std::size_t, std::size_t) {
+    mark(books, proj, hashes, partitions[p], keep, survivors);
+  });
+
+  // 4.
+  return compact(books, survivors, order);
+}
+
+/*
+ * Compile-time tests
+ */
+namespace dedupe_books_test {
+
+using Book = Book<std::string_view>;
+
+constexpr auto input = std::to_array<Book>({
+    {"Effective C++", "1"},
+    {"Exceptional C++", "2"},
+    {"Effective C++", "3"},
+    {"C++ Concurrency in Action", "4"},
+    {"Effective C++", "5"},
+    {"Exceptional C++", "6"},
+});
+
+template <typename... Isbns>
+consteval auto test(DedupeKeep keep, DedupeOrder order, Isbns... expected)
+    -> bool {
+  auto books = std::vector<Book>(input.begin(), input.end());
+  auto removed = dedupe_by<Version::Ranges>(books, &Book::title, keep, order);
+  return removed == 3 &&
+         std::ranges::equal(books, std::array{std::string_view(expected)...},
+                            {}, &Book::isbn);
+}
+
+static_assert(test(DedupeKeep::First, DedupeOrder::Stable, "1", "2", "4"));
+static_assert(test(DedupeKeep::Last, DedupeOrder::Stable, "4", "5", "6"));
+static_assert(test(DedupeKeep::First, DedupeOrder::Unstable, "1", "2", "4"));
+static_assert(test(DedupeKeep::Last, DedupeOrder::Unstable, "6", "5", "4"));
+
+consteval auto test_isbn() -> bool {
+  auto books = std::vector<Book>(input.begin(), input.end());
+  return dedupe_by<Version::Ranges>(books, &Book::isbn) == 0 &&
+         books.size() == input.size();
+}
+
+static_assert(test_isbn());
+
+} // namespace dedupe_books_test
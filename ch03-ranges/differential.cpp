@@ -0,0 +1,510 @@
+/*
+ * Differential testing of the Version variants of the chapter, see
+ * bench/differential.h.
+ *
+ *   ch03-differential [--filter=sort] [--seeds=100] [--max-size=1K]
+ *
+ * The parallel variants only start threads for large enough inputs (see
+ * chunk_count), so the largest sizes are there for them, and they are only
+ * really checked on a machine with several cores.
+ *
+ * The runtime tests of the chapter run first.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <random>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "autotuner.h"
+#include "dedupe_books.h"
+#include "differential.h"
+#include "external_sort_books.h"
+#include "fast_paths.h"
+#include "hashed_string.h"
+#include "hash_join.h"
+#include "isbn.h"
+#include "merge_books.h"
+#include "odd_numbers.h"
+#include "random_books.h"
+#include "snapshot_catalog.h"
+#include "sort_books.h"
+#include "string_set_matcher.h"
+#include "strings_equal.h"
+#include "title_index.h"
+#include "top_k_books.h"
+#include "version.h"
+
+namespace {
+
+using CheckedBook = Book<std::string>;
+using Books = std::vector<CheckedBook>;
+
+/*
+ * Titles drawn from about size / 4 titles, so that there are many equal ones,
+ * which is where the variants may differ; the isbns are unique.
+ */
+auto generate_books(std::mt19937_64 &rng, std::size_t size) -> Books {
+  return random_books(rng(), size, size / 4 + 1);
+}
+
+/*
+ * Variants which aren't Versions get an enum of their own, like the Versions
+ * of the chapter
+ */
+enum class Merge { Eager, Lazy };
+
+auto merge_name(Merge merge) -> std::string_view {
+  return merge == Merge::Eager ? "merge_sorted" : "views::merge_sorted";
+}
+
+enum class Lookup { Find, Matcher };
+
+auto lookup_name(Lookup lookup) -> std::string_view {
+  return lookup == Lookup::Find ? "ranges::find" : "string_set_matcher";
+}
+
+enum class Bulk { Std, Fast };
+
+auto bulk_name(Bulk bulk) -> std::string_view {
+  return bulk == Bulk::Std ? "std::ranges" : "fast";
+}
+
+// byte comparable, without an operator==
+struct Code {
+  std::uint32_t value;
+  constexpr static bool is_byte_comparable = true;
+};
+
+// what the elements are compared by in the results
+template <typename T> auto key_of(const T &value) { return value; }
+auto key_of(const Code &code) { return code.value; }
+
+/*
+ * A container made of several blocks, which gets the segmented fast paths
+ * through its segments() member; the blocks are random, empty ones included.
+ */
+template <typename T> struct Chunked {
+  std::vector<std::vector<T>> chunks;
+
+  auto segments() const {
+    return chunks | std::views::transform([](const std::vector<T> &chunk) {
+             return std::span<const T>(chunk);
+           });
+  }
+  auto elements() const { return chunks | std::views::join; }
+};
+
+template <typename T>
+auto chunked(std::mt19937_64 &rng, const std::vector<T> &elements)
+    -> Chunked<T> {
+  auto result = Chunked<T>();
+  for (auto it = elements.begin();;) {
+    auto size = std::min(static_cast<std::ptrdiff_t>(rng() % 40),
+                         elements.end() - it);
+    result.chunks.emplace_back(it, it + size);
+    it += size;
+    if (it == elements.end()) {
+      return result;
+    }
+  }
+}
+
+/*
+ * Checks fast::copy and fast::equal against std::ranges::copy and
+ * std::ranges::equal. size is the number of elements, from a small alphabet;
+ * the pairs are equal, but cut into blocks differently, or differ in one
+ * element or in the length.
+ */
+template <typename T>
+auto add_fast_paths(bench::Differential &differential, std::string name)
+    -> void {
+  using Pairs = std::vector<std::pair<Chunked<T>, Chunked<T>>>;
+  const auto sizes = std::vector<std::size_t>{0, 1, 100, 10'000};
+
+  auto generate = [](std::mt19937_64 &rng, std::size_t size) {
+    auto pairs = Pairs();
+    for (auto i = 0; i < 20; ++i) {
+      auto elements = std::vector<T>(size);
+      std::ranges::generate(elements, [&] {
+        if constexpr (std::same_as<T, Code>) {
+          return Code{static_cast<std::uint32_t>(rng() % 2)};
+        } else {
+          return static_cast<T>(rng() % 2);
+        }
+      });
+      auto other = elements;
+      if (rng() % 3 == 0 && !other.empty()) {
+        other[rng() % other.size()] = T{3};
+      } else if (rng() % 3 == 0 && !other.empty()) {
+        other.pop_back();
+      }
+      pairs.emplace_back(chunked(rng, elements), chunked(rng, other));
+    }
+    return pairs;
+  };
+
+  differential.add<Bulk::Std, Bulk::Fast>(
+      "fast::copy " + name, sizes, bulk_name, generate,
+      []<Bulk bulk>(Pairs pairs) {
+        auto keys = std::vector<std::vector<std::uint32_t>>();
+        for (const auto &[lhs, _] : pairs) {
+          auto out = std::vector<T>(std::ranges::distance(lhs.elements()));
+          if constexpr (bulk == Bulk::Std) {
+            std::ranges::copy(lhs.elements(), out.data());
+          } else {
+            fast::copy(lhs, out.data());
+          }
+          auto &copied = keys.emplace_back();
+          for (const auto &value : out) {
+            copied.push_back(static_cast<std::uint32_t>(key_of(value)));
+          }
+        }
+        return keys;
+      });
+
+  differential.add<Bulk::Std, Bulk::Fast>(
+      "fast::equal " + name, sizes, bulk_name, generate,
+      []<Bulk bulk>(Pairs pairs) {
+        auto equal = std::vector<bool>();
+        for (const auto &[lhs, rhs] : pairs) {
+          if constexpr (bulk == Bulk::Std) {
+            auto key = [](const T &value) { return key_of(value); };
+            equal.push_back(std::ranges::equal(lhs.elements(), rhs.elements(),
+                                               {}, key, key));
+          } else {
+            equal.push_back(fast::equal(lhs, rhs));
+          }
+        }
+        return equal;
+      });
+}
+
+auto titles_of(const Books &books) -> std::vector<std::string> {
+  auto titles = std::vector<std::string>();
+  for (const auto &book : books) {
+    titles.push_back(book.title);
+  }
+  return titles;
+}
+
+/*
+ * The order of the books with equal titles is unspecified after a sort, so
+ * they are ordered by isbn; the order of the titles stays as it was, so an
+ * unsorted result is still told apart.
+ */
+auto order_equal_titles(Books books) -> Books {
+  for (auto first = books.begin(); first != books.end();) {
+    auto last = std::find_if(first, books.end(), [&](const auto &book) {
+      return book.title != first->title;
+    });
+    std::sort(first, last, [](const auto &lhs, const auto &rhs) {
+      return lhs.isbn < rhs.isbn;
+    });
+    first = last;
+  }
+  return books;
+}
+
+// for the results which are sets
+auto sorted_by_all(Books books) -> Books {
+  std::ranges::sort(books, {}, [](const CheckedBook &book) {
+    return std::tie(book.title, book.isbn);
+  });
+  return books;
+}
+
+/*
+ * An ISBN-13 string with a correct check digit and hyphens at random places,
+ * then maybe broken: a wrong check digit, a digit too many or too few, a
+ * hyphen at an end or doubled, or any other byte somewhere (including the
+ * neighbours of the digits, '/' and ':', and bytes above 0x7f).
+ */
+auto random_isbn(std::mt19937_64 &rng) -> std::string {
+  auto digits = std::string(12, '0');
+  auto sum = 0;
+  for (auto i = std::size_t{0}; i < digits.size(); ++i) {
+    auto digit = static_cast<int>(rng() % 10);
+    digits[i] = static_cast<char>('0' + digit);
+    sum += digit * (i % 2 == 0 ? 1 : 3);
+  }
+  digits += static_cast<char>('0' + (10 - sum % 10) % 10);
+
+  auto position = [&](const std::string &str) {
+    return static_cast<std::ptrdiff_t>(rng() % (str.size() + 1));
+  };
+  switch (rng() % 8) {
+  case 0: // a wrong check digit
+    digits.back() = static_cast<char>('0' + (digits.back() - '0' + 1) % 10);
+    break;
+  case 1: // a digit too many
+    digits.insert(digits.begin() + position(digits), '7');
+    break;
+  case 2: // a digit too few
+    digits.erase(digits.begin() + position(digits) % 13);
+    break;
+  default:
+    break;
+  }
+
+  auto isbn = std::string();
+  for (auto digit : digits) {
+    if (!isbn.empty() && rng() % 4 == 0) {
+      isbn += '-';
+    }
+    isbn += digit;
+  }
+
+  switch (rng() % 8) {
+  case 0: // a hyphen at an end, or doubled
+    isbn.insert(isbn.begin() + (rng() % 2 == 0 ? 0 : position(isbn)), '-');
+    break;
+  case 1: // any byte
+    isbn.insert(isbn.begin() + position(isbn), static_cast<char>(rng()));
+    break;
+  case 2:
+    isbn[static_cast<std::size_t>(position(isbn)) % isbn.size()] =
+        "/: x\x80\xff"[rng() % 6];
+    break;
+  default:
+    break;
+  }
+  return isbn;
+}
+
+auto random_isbns(std::mt19937_64 &rng, std::size_t size)
+    -> std::vector<std::string> {
+  auto strings = std::vector<std::string>();
+  for (auto i = std::size_t{0}; i < size; ++i) {
+    strings.push_back(random_isbn(rng));
+  }
+  // and a few which are too long or empty
+  strings.emplace_back();
+  strings.push_back(random_isbn(rng) + "-0000");
+  return strings;
+}
+
+auto differential() -> bench::Differential {
+  auto differential = bench::Differential();
+  differential.add_test("autotuner", autotuner_test);
+  differential.add_test("external_sort", external_sort_test);
+  differential.add_test("title_index_file", title_index_file_test);
+  differential.add_test("snapshot_catalog", snapshot_catalog_test);
+  differential.add_test("hashed_string", hashed_string_collision_test);
+
+  const auto sizes = std::vector<std::size_t>{0, 1, 17, 1'000, 100'000};
+
+  differential.add<Version::Iterator, Version::Ranges>(
+      "doubled_odd_numbers", sizes, version_name,
+      [](std::mt19937_64 &rng, std::size_t size) {
+        // negative numbers too, whose remainder is -1 for the odd ones; half
+        // the int range, so that doubling them doesn't overflow
+        auto numbers = std::vector<int>(size);
+        auto value = std::uniform_int_distribution<int>(
+            std::numeric_limits<int>::min() / 2,
+            std::numeric_limits<int>::max() / 2);
+        std::ranges::generate(numbers, [&] { return value(rng); });
+        return numbers;
+      },
+      []<Version version>(std::vector<int> numbers) {
+        return doubled_odd_numbers<version>(numbers);
+      });
+
+  // size is the longest string; the pairs are equal, or differ in a single
+  // byte anywhere, or in the length only
+  differential.add<Version::Iterator, Version::Ranges, Version::Simd>(
+      "strings_equal", {1, 16, 100, 1'000}, version_name,
+      [](std::mt19937_64 &rng, std::size_t size) {
+        auto pairs = std::vector<std::pair<std::string, std::string>>();
+        for (auto i = 0; i < 1'000; ++i) {
+          auto lhs = std::string(rng() % (size + 1), ' ');
+          std::ranges::generate(
+              lhs, [&] { return static_cast<char>('a' + rng() % 2); });
+          auto rhs = lhs;
+          if (rng() % 3 == 0 && !rhs.empty()) {
+            rhs[rng() % rhs.size()] ^= 1;
+          } else if (rng() % 3 == 0 && !rhs.empty()) {
+            rhs.pop_back();
+          }
+          pairs.emplace_back(std::move(lhs), std::move(rhs));
+        }
+        return pairs;
+      },
+      []<Version version>(std::vector<std::pair<std::string, std::string>>
+                              pairs) {
+        auto equal = std::vector<bool>();
+        for (const auto &[lhs, rhs] : pairs) {
+          equal.push_back(strings_equal<version>(lhs, rhs));
+        }
+        return equal;
+      });
+
+  differential.add<Version::Iterator, Version::Ranges>(
+      "sort", sizes, version_name, generate_books,
+      []<Version version>(Books books) {
+        sort<version>(books);
+        return books;
+      },
+      order_equal_titles);
+
+  // which of the books with the k-th title make it is unspecified, so only
+  // the titles are compared
+  auto top_k_input = [](std::mt19937_64 &rng, std::size_t size) {
+    auto books = generate_books(rng, size);
+    // now and then a k way larger than any catalog
+    auto k = rng() % 8 == 0 ? std::size_t{1} << 40
+                            : std::size_t(rng() % (size + 2));
+    return std::pair(std::move(books), k);
+  };
+  differential.add<Version::Iterator, Version::Ranges, Version::Parallel>(
+      "top_k", sizes, version_name, top_k_input,
+      []<Version version>(std::pair<Books, std::size_t> input) {
+        return titles_of(top_k<version>(input.first, input.second));
+      });
+  differential.add<Version::Iterator, Version::Ranges, Version::Parallel>(
+      "top_k_stream", sizes, version_name, top_k_input,
+      []<Version version>(std::pair<Books, std::size_t> input) {
+        return titles_of(top_k_stream<version>(input.first, input.second));
+      });
+
+  auto merge_input = [](std::mt19937_64 &rng, std::size_t size) {
+    auto books = generate_books(rng, size);
+    auto inputs = std::vector<Books>(rng() % 8 + 1);
+    for (auto &book : books) {
+      inputs[rng() % inputs.size()].push_back(std::move(book));
+    }
+    for (auto &input : inputs) {
+      std::ranges::stable_sort(input, {}, &CheckedBook::title);
+    }
+    return inputs;
+  };
+  differential.add<Version::Ranges, Version::Parallel>(
+      "merge_sorted", sizes, version_name, merge_input,
+      []<Version version>(std::vector<Books> inputs) {
+        return merge_sorted<version>(inputs);
+      });
+  // the lazy view against the eager merge
+  differential.add<Merge::Eager, Merge::Lazy>(
+      "views::merge_sorted", sizes, merge_name, merge_input,
+      []<Merge merge>(std::vector<Books> inputs) {
+        if constexpr (merge == Merge::Eager) {
+          return merge_sorted<Version::Ranges>(inputs);
+        } else {
+          auto merged = Books();
+          for (const auto &book : views::merge_sorted(inputs)) {
+            merged.push_back(book);
+          }
+          return merged;
+        }
+      });
+
+  differential.add<Version::Ranges, Version::Parallel>(
+      "dedupe_by stable", sizes, version_name, generate_books,
+      []<Version version>(Books books) {
+        auto removed = dedupe_by<version>(books, &CheckedBook::title,
+                                          DedupeKeep::Last);
+        return std::pair(removed, books);
+      });
+  differential.add<Version::Ranges, Version::Parallel>(
+      "dedupe_by unstable", sizes, version_name, generate_books,
+      []<Version version>(Books books) {
+        dedupe_by<version>(books, &CheckedBook::title, DedupeKeep::First,
+                           DedupeOrder::Unstable);
+        return books;
+      },
+      sorted_by_all);
+
+  // the parallel version only partitions with 16K rows on the smaller side
+  differential.add<Version::Ranges, Version::Parallel>(
+      "hash_join", sizes, version_name,
+      [](std::mt19937_64 &rng, std::size_t size) {
+        auto titles = titles_of(generate_books(rng, size));
+        auto middle = titles.begin() + static_cast<std::ptrdiff_t>(
+                                           rng() % (titles.size() + 1));
+        return std::pair(std::vector(titles.begin(), middle),
+                         std::vector(middle, titles.end()));
+      },
+      []<Version version>(
+          std::pair<std::vector<std::string>, std::vector<std::string>>
+              input) {
+        auto matches = hash_join<version>(input.first, input.second);
+        std::ranges::sort(matches);
+        return matches;
+      });
+
+  // size is the number of strings: valid ISBNs, with or without hyphens,
+  // and broken ones, which both parsers have to reject the same way
+  differential.add<Version::Iterator, Version::Simd>(
+      "Isbn::parse", {1, 1'000, 100'000}, version_name, random_isbns,
+      []<Version version>(std::vector<std::string> strings) {
+        auto parsed = std::vector<std::optional<Isbn>>();
+        for (const auto &str : strings) {
+          parsed.push_back(Isbn::parse<version>(str));
+        }
+        return parsed;
+      });
+
+  // size is the number of keys; short keys from a 3-letter alphabet share
+  // fingerprints a lot, so the string compares after the SIMD scan matter;
+  // half of the tokens are keys, the others mostly near misses
+  using KeysAndTokens =
+      std::pair<std::vector<std::string>, std::vector<std::string>>;
+  differential.add<Lookup::Find, Lookup::Matcher>(
+      "string_set_matcher", {0, 1, 7, 100, 1'000}, lookup_name,
+      [](std::mt19937_64 &rng, std::size_t size) {
+        auto word = [&rng] {
+          auto str = std::string(rng() % 7, ' ');
+          std::ranges::generate(
+              str, [&] { return static_cast<char>('a' + rng() % 3); });
+          return str;
+        };
+        auto input = KeysAndTokens();
+        std::ranges::generate_n(std::back_inserter(input.first), size, word);
+        for (auto i = 0; i < 1'000; ++i) {
+          input.second.push_back(size > 0 && rng() % 2 == 0
+                                     ? input.first[rng() % size]
+                                     : word());
+        }
+        return input;
+      },
+      []<Lookup lookup>(KeysAndTokens input) {
+        const auto &[keys, tokens] = input;
+        auto found = std::vector<std::optional<std::size_t>>();
+        if constexpr (lookup == Lookup::Find) {
+          for (const auto &token : tokens) {
+            auto it = std::ranges::find(keys, token);
+            found.push_back(it == keys.end()
+                                ? std::nullopt
+                                : std::optional(static_cast<std::size_t>(
+                                      it - keys.begin())));
+          }
+        } else {
+          auto matcher = string_set_matcher(keys);
+          for (const auto &token : tokens) {
+            found.push_back(matcher.find(token));
+          }
+        }
+        return found;
+      });
+
+  add_fast_paths<char>(differential, "char");
+  add_fast_paths<int>(differential, "int");
+  add_fast_paths<Code>(differential, "Code");
+
+  return differential;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  return bench::differential_main(argc, argv, differential());
+}
@@ -0,0 +1,308 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <iterator>
+#include <ranges>
+#include <span>
+#include <type_traits>
+
+#include "strings_equal.h"
+
+/*
+ * Customization points which let user containers opt into the bulk fast paths
+ * (memcpy, memcmp), the same way uniform_begin.h shows for begin: a member
+ * function or a free function found by ADL, so a type doesn't have to be (or
+ * to be rewritten as) a std container to get them.
+ *
+ * - fast::data_size(c): the elements of a contiguous container, as a span,
+ * - fast::segments(c): the elements of a container made of several
+ *   contiguous blocks (a deque, a rope, a chain of buffers...), as a range of
+ *   spans, one per block,
+ * - fast::is_byte_comparable<T>: whether comparing the bytes of two Ts is
+ *   the same as comparing the Ts with ==, so that memcmp can be used.
+ *
+ * Like std::ranges::begin, the first two are customization point objects:
+ * function objects which try the member function first, then the free
+ * function (only found by ADL, see the deleted declarations in details), and
+ * then the standard way (contiguous ranges are their own single segment).
+ * Being objects, they can't be hijacked by ADL themselves, and can be passed
+ * to algorithms.
+ */
+namespace fast {
+namespace details {
+
+// poison pills: unqualified calls below find only the ADL candidates
+void data_size() = delete;
+void segments() = delete;
+
+template <typename R>
+concept span_like = std::ranges::contiguous_range<R> &&
+                    std::ranges::sized_range<R> &&
+                    std::ranges::borrowed_range<R>;
+
+template <typename R>
+constexpr auto to_span(R &&range) {
+  return std::span(std::ranges::data(range), std::ranges::size(range));
+}
+
+template <typename C>
+concept member_data_size = requires(C &c) {
+  { c.data_size() } -> span_like;
+};
+
+template <typename C>
+concept adl_data_size = requires(C &c) {
+  { data_size(c) } -> span_like;
+};
+
+template <typename C>
+concept std_data_size =
+    std::ranges::contiguous_range<C> && std::ranges::sized_range<C>;
+
+struct data_size_fn {
+  template <typename C>
+    requires member_data_size<C> || adl_data_size<C> || std_data_size<C>
+  constexpr auto operator()(C &c) const {
+    if constexpr (member_data_size<C>) {
+      return to_span(c.data_size());
+    } else if constexpr (adl_data_size<C>) {
+      return to_span(data_size(c));
+    } else {
+      return to_span(c);
+    }
+  }
+};
+
+template <typename S>
+concept range_of_spans =
+    std::ranges::input_range<S> &&
+    span_like<std::ranges::range_reference_t<S>>;
+
+template <typename C>
+concept member_segments = requires(C &c) {
+  { c.segments() } -> range_of_spans;
+};
+
+template <typename C>
+concept adl_segments = requires(C &c) {
+  { segments(c) } -> range_of_spans;
+};
+
+struct segments_fn {
+  template <typename C>
+    requires member_segments<C> || adl_segments<C> ||
+             std::invocable<const data_size_fn &, C &>
+  constexpr auto operator()(C &c) const {
+    if constexpr (member_segments<C>) {
+      return c.segments();
+    } else if constexpr (adl_segments<C>) {
+      return segments(c);
+    } else {
+      return std::array{data_size_fn()(c)};
+    }
+  }
+};
+
+template <typename T> constexpr auto member_byte_comparable() -> bool {
+  if constexpr (requires { T::is_byte_comparable; }) {
+    return T::is_byte_comparable;
+  } else {
+    return false;
+  }
+}
+
+} // namespace details
+
+inline constexpr details::data_size_fn data_size{};
+inline constexpr details::segments_fn segments{};
+
+/*
+ * Integers, enums and pointers are equal exactly when their bytes are; floats
+ * aren't (0.0 == -0.0, NaN != NaN), and neither are structs in general
+ * (padding bytes, user-defined ==). Other types opt in with a member
+ *   constexpr static bool is_byte_comparable = true;
+ * or by specializing enable_byte_comparable.
+ */
+template <typename T>
+inline constexpr bool enable_byte_comparable =
+    std::is_integral_v<T> || std::is_enum_v<T> || std::is_pointer_v<T> ||
+    details::member_byte_comparable<T>();
+
+template <typename T>
+inline constexpr bool is_byte_comparable =
+    enable_byte_comparable<std::remove_cv_t<T>>;
+
+template <typename C>
+using segment_element_t = std::remove_cv_t<typename std::ranges::range_value_t<
+    decltype(segments(std::declval<C &>()))>::element_type>;
+
+/*
+ * Copies all the elements of the container to out, a segment at a time, with
+ * memcpy for trivially copyable elements; returns the end of the output.
+ */
+template <typename C, typename T>
+  requires std::invocable<const details::segments_fn &, const C &> &&
+           std::same_as<segment_element_t<const C>, T>
+constexpr auto copy(const C &c, T *out) -> T * {
+  for (auto segment : segments(c)) {
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      if !consteval {
+        if (!segment.empty()) {
+          std::memcpy(out, segment.data(), segment.size_bytes());
+        }
+        out += segment.size();
+        continue;
+      }
+    }
+    out = std::ranges::copy(segment, out).out;
+  }
+  return out;
+}
+
+/*
+ * Compares the elements of two containers, which may be segmented
+ * differently: both sequences of segments are walked at once, comparing the
+ * overlapping parts, with the SIMD compare of strings_equal.h for chars and
+ * memcmp for other byte comparable elements. A byte comparable type doesn't
+ * need an operator==: at compile time, where memcmp isn't usable, its bytes
+ * are compared through std::bit_cast.
+ */
+template <typename L, typename R>
+  requires std::invocable<const details::segments_fn &, const L &> &&
+           std::invocable<const details::segments_fn &, const R &> &&
+           std::same_as<segment_element_t<const L>,
+                        segment_element_t<const R>> &&
+           (std::equality_comparable<segment_element_t<const L>> ||
+            is_byte_comparable<segment_element_t<const L>>)
+constexpr auto equal(const L &lhs, const R &rhs) -> bool {
+  using T = segment_element_t<const L>;
+
+  if constexpr (std::ranges::sized_range<const L> &&
+                std::ranges::sized_range<const R>) {
+    if (std::ranges::size(lhs) != std::ranges::size(rhs)) {
+      return false;
+    }
+  }
+
+  auto equal_parts = [](auto l, auto r) {
+    if constexpr (std::same_as<T, char>) {
+      if !consteval {
+        return strings_equal_details::equal_simd(l.data(), r.data(), l.size());
+      }
+    } else if constexpr (is_byte_comparable<T>) {
+      if !consteval {
+        return std::memcmp(l.data(), r.data(), l.size_bytes()) == 0;
+      }
+    }
+    if constexpr (std::equality_comparable<T>) {
+      return std::ranges::equal(l, r);
+    } else {
+      auto bytes = [](const T &value) {
+        return std::bit_cast<std::array<unsigned char, sizeof(T)>>(value);
+      };
+      return std::ranges::equal(l, r, {}, bytes, bytes);
+    }
+  };
+
+  auto lhs_segments = segments(lhs);
+  auto rhs_segments = segments(rhs);
+  auto l_it = std::ranges::begin(lhs_segments);
+  auto r_it = std::ranges::begin(rhs_segments);
+  auto l = std::span<const T>();
+  auto r = std::span<const T>();
+
+  while (true) {
+    while (l.empty() && l_it != std::ranges::end(lhs_segments)) {
+      l = *l_it++;
+    }
+    while (r.empty() && r_it != std::ranges::end(rhs_segments)) {
+      r = *r_it++;
+    }
+    if (l.empty() || r.empty()) {
+      // equal only if both are exhausted
+      return l.empty() && r.empty();
+    }
+
+    auto n = std::min(l.size(), r.size());
+    if (!equal_parts(l.first(n), r.first(n))) {
+      return false;
+    }
+    l = l.subspan(n);
+    r = r.subspan(n);
+  }
+}
+
+} // namespace fast
+
+/*
+ * Compile-time tests
+ */
+namespace fast_paths_test {
+
+// contiguous through a free function found by ADL
+struct ByteBuffer {
+  std::array<char, 8> storage;
+  std::size_t used;
+};
+
+constexpr auto data_size(const ByteBuffer &buffer) -> std::span<const char> {
+  return std::span(buffer.storage).first(buffer.used);
+}
+
+// segmented through a member function
+struct ChunkedBuffer {
+  std::array<char, 4> head;
+  std::array<char, 4> tail;
+
+  constexpr auto segments() const {
+    return std::array{std::span<const char>(head),
+                      std::span<const char>(tail).first(2)};
+  }
+};
+
+struct Id {
+  int value;
+  constexpr static bool is_byte_comparable = true;
+};
+
+static_assert(fast::is_byte_comparable<char>);
+static_assert(fast::is_byte_comparable<const int *>);
+static_assert(fast::is_byte_comparable<Id>);
+static_assert(!fast::is_byte_comparable<double>);
+static_assert(!fast::is_byte_comparable<std::span<char>>);
+
+constexpr auto buffer = ByteBuffer{{'C', '+', '+', '2', '0', 'x', 'x'}, 5};
+constexpr auto chunked = ChunkedBuffer{{'C', '+', '+', '2'}, {'0', 'x'}};
+constexpr auto plain = std::to_array({'C', '+', '+', '2', '0'});
+
+static_assert(fast::data_size(buffer).size() == 5);
+static_assert(fast::data_size(plain).size() == 5);
+static_assert(std::ranges::size(fast::segments(chunked)) == 2);
+static_assert(std::ranges::size(fast::segments(buffer)) == 1);
+
+consteval auto test_copy() -> bool {
+  auto out = std::array<char, 6>{};
+  auto end = fast::copy(chunked, out.data());
+  return end == out.data() + 6 &&
+         std::ranges::equal(out, std::array{'C', '+', '+', '2', '0', 'x'});
+}
+
+static_assert(test_copy());
+
+static_assert(fast::equal(buffer, plain));
+static_assert(fast::equal(plain, buffer));
+static_assert(!fast::equal(chunked, plain));
+static_assert(fast::equal(chunked, ChunkedBuffer{{'C', '+', '+', '2'},
+                                                 {'0', 'x', 'y', 'z'}}));
+static_assert(!fast::equal(buffer, std::to_array({'C', '+', '+', '2', '1'})));
+
+// Id has no operator==
+static_assert(fast::equal(std::to_array<Id>({{1}, {2}}),
+                          std::to_array<Id>({{1}, {2}})));
+static_assert(!fast::equal(std::to_array<Id>({{1}, {2}}),
+                           std::to_array<Id>({{1}, {3}})));
+
+} // namespace fast_paths_test
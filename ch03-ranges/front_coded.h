@@ -0,0 +1,290 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "sort_books.h"
+
+/*
+ * Compressed storage for a sorted list of strings (e.g. the titles after
+ * sort<version>), with front coding: neighbours in a sorted list tend to share
+ * a prefix ("Effective C++", "Effective Modern C++", "Effective STL"), so every
+ * string is stored as the length of the prefix it shares with the previous one,
+ * plus the rest:
+ *   Effective C++ | 10 "Modern C++" | 10 "STL"
+ *
+ * Decoding a string then requires all the previous ones, so the strings are
+ * grouped in blocks of block_size, and the first string of every block (the
+ * head) is stored in full. Reading a string decodes at most block_size strings
+ * of its block, and lookups are a binary search over the heads, followed by a
+ * linear scan of a single block. The only extra index is one offset per block,
+ * so for a large list it's small enough to stay in the cache.
+ *
+ * The lengths are varints (7 bits per byte, the high bit says "more bytes"), so
+ * short titles need one byte per length.
+ */
+class FrontCodedStrings {
+  std::vector<char> bytes_;
+  // offset of every block in bytes_
+  std::vector<std::uint32_t> blocks_;
+  std::size_t size_ = 0;
+  std::size_t block_size_ = 16;
+
+  constexpr auto put_varint(std::size_t value) -> void {
+    while (value >= 0x80) {
+      bytes_.push_back(static_cast<char>((value & 0x7F) | 0x80));
+      value >>= 7;
+    }
+    bytes_.push_back(static_cast<char>(value));
+  }
+
+  constexpr auto get_varint(std::size_t &pos) const -> std::size_t {
+    auto value = std::size_t{0};
+    for (auto shift = 0;; shift += 7) {
+      auto byte = static_cast<unsigned char>(bytes_[pos++]);
+      value |= std::size_t{byte & 0x7Fu} << shift;
+      if (byte < 0x80) {
+        return value;
+      }
+    }
+  }
+
+  // the head of the block is stored in full, so it's read without decoding
+  constexpr auto head(std::size_t block) const -> std::string_view {
+    auto pos = std::size_t{blocks_[block]};
+    auto length = get_varint(pos);
+    return {bytes_.data() + pos, length};
+  }
+
+  /*
+   * Decodes the string at the given index into current, which has to contain
+   * the previous string, unless it's a head; pos is where the string is
+   * encoded, and is moved past it.
+   */
+  constexpr auto decode(std::size_t index, std::size_t &pos,
+                        std::vector<char> &current) const -> void {
+    auto shared = index % block_size_ == 0 ? 0 : get_varint(pos);
+    auto length = get_varint(pos);
+    current.resize(shared);
+    current.insert(current.end(), bytes_.data() + pos,
+                   bytes_.data() + pos + length);
+    pos += length;
+  }
+
+public:
+  /*
+   * Sequential decoding: every iterator keeps the current string, which is
+   * updated in place on increments. The string_view returned by operator* is
+   * valid until the iterator is incremented or destroyed.
+   */
+  class iterator {
+    const FrontCodedStrings *strings_ = nullptr;
+    std::size_t index_ = 0;
+    std::size_t pos_ = 0;
+    std::vector<char> current_;
+
+    constexpr auto load() -> void {
+      if (index_ < strings_->size_) {
+        strings_->decode(index_, pos_, current_);
+      }
+    }
+
+  public:
+    using value_type = std::string;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+    constexpr iterator(const FrontCodedStrings &strings, std::size_t block)
+        : strings_(&strings),
+          index_(std::min(block * strings.block_size_, strings.size_)),
+          pos_(block < strings.blocks_.size() ? strings.blocks_[block] : 0) {
+      load();
+    }
+
+    constexpr auto operator*() const -> std::string_view {
+      return {current_.data(), current_.size()};
+    }
+
+    constexpr auto operator++() -> iterator & {
+      ++index_;
+      load();
+      return *this;
+    }
+    constexpr auto operator++(int) -> iterator {
+      auto copy = *this;
+      ++*this;
+      return copy;
+    }
+
+    constexpr auto index() const -> std::size_t { return index_; }
+
+    friend constexpr auto operator==(const iterator &lhs, const iterator &rhs)
+        -> bool {
+      return lhs.index_ == rhs.index_;
+    }
+  };
+
+  FrontCodedStrings() = default;
+
+  /*
+   * The strings have to be sorted, as lookups rely on it; throws
+   * std::invalid_argument if they aren't.
+   */
+  template <std::ranges::input_range R>
+    requires std::convertible_to<std::ranges::range_reference_t<R>,
+                                 std::string_view>
+  constexpr explicit FrontCodedStrings(R &&sorted, std::size_t block_size = 16)
+      : block_size_(std::max(block_size, std::size_t{1})) {
+    // compared as std::string_view, that is as unsigned chars, like the
+    // lookups do: UTF-8 titles sort after the ASCII ones
+    auto previous = std::string();
+    for (std::string_view str : sorted) {
+      if (str < std::string_view(previous)) {
+        throw std::invalid_argument("FrontCodedStrings: unsorted input");
+      }
+
+      if (size_ % block_size_ == 0) {
+        blocks_.push_back(static_cast<std::uint32_t>(bytes_.size()));
+        put_varint(str.size());
+        bytes_.insert(bytes_.end(), str.begin(), str.end());
+      } else {
+        auto shared = static_cast<std::size_t>(
+            std::ranges::mismatch(str, previous).in1 - str.begin());
+        put_varint(shared);
+        put_varint(str.size() - shared);
+        bytes_.insert(bytes_.end(), str.begin() + shared, str.end());
+      }
+
+      previous.assign(str.begin(), str.end());
+      ++size_;
+    }
+  }
+
+  constexpr auto size() const -> std::size_t { return size_; }
+  constexpr auto empty() const -> bool { return size_ == 0; }
+
+  // the encoded strings and the block index, in bytes
+  constexpr auto memory() const -> std::size_t {
+    return bytes_.size() + blocks_.size() * sizeof(std::uint32_t);
+  }
+
+  constexpr auto begin() const -> iterator { return {*this, 0}; }
+  constexpr auto end() const -> iterator { return {*this, blocks_.size()}; }
+
+  // decodes up to block_size strings
+  constexpr auto operator[](std::size_t index) const -> std::string {
+    auto it = iterator(*this, index / block_size_);
+    while (it.index() < index) {
+      ++it;
+    }
+    return std::string(*it);
+  }
+
+  /*
+   * The index of the first string not less than the value, O(log(n / k) + k)
+   * for blocks of k strings: the binary search finds the first block with the
+   * head not less than the value, and the answer is either in the block
+   * before it, or is that head.
+   */
+  constexpr auto lower_bound(std::string_view value) const -> std::size_t {
+    auto blocks = std::views::iota(std::size_t{0}, blocks_.size());
+    auto next = std::ranges::partition_point(
+        blocks, [&](std::size_t block) { return head(block) < value; });
+    if (next == blocks.begin()) {
+      return 0;
+    }
+
+    auto block = *std::ranges::prev(next);
+    auto last = std::min(size_, (block + 1) * block_size_);
+    for (auto it = iterator(*this, block); it.index() < last; ++it) {
+      if (*it >= value) {
+        return it.index();
+      }
+    }
+    return last;
+  }
+
+  constexpr auto contains(std::string_view value) const -> bool {
+    auto index = lower_bound(value);
+    return index < size_ && (*this)[index] == value;
+  }
+};
+
+/*
+ * Compile-time tests
+ */
+namespace front_coded_test {
+
+using Book = Book<std::string_view>;
+
+constexpr auto titles = std::to_array<std::string_view>({
+    "",
+    "C++ Concurrency in Action",
+    "C++ Templates",
+    "Effective C++",
+    "Effective Modern C++",
+    "Effective STL",
+    "Exceptional C++",
+    "Exceptional C++ Style",
+    "The C++ Programming Language",
+    "The C++ Standard Library",
+});
+
+static_assert(std::ranges::forward_range<FrontCodedStrings>);
+
+template <std::size_t block_size> consteval auto test() -> bool {
+  auto strings = FrontCodedStrings(titles, block_size);
+
+  auto all_found = std::ranges::all_of(titles, [&](std::string_view title) {
+    return strings.contains(title) &&
+           strings[strings.lower_bound(title)] == title;
+  });
+
+  return strings.size() == titles.size() &&
+         std::ranges::equal(strings, titles) && all_found &&
+         strings.lower_bound("Effective") == 3 &&
+         strings.lower_bound("Effective D") == 4 &&
+         strings.lower_bound("Z") == titles.size() &&
+         !strings.contains("Effective") && !strings.contains("Z");
+}
+
+static_assert(test<1>());
+static_assert(test<3>());
+static_assert(test<4>());
+static_assert(test<16>());
+
+consteval auto test_books() -> bool {
+  auto books = std::to_array<Book>({
+      {"Effective STL", "3"},
+      {"Effective C++", "1"},
+      {"Effective Modern C++", "2"},
+  });
+  sort<Version::Ranges>(books);
+
+  auto strings = FrontCodedStrings(books | std::views::transform(&Book::title));
+  return strings.memory() < std::string_view("Effective C++"
+                                             "Effective Modern C++"
+                                             "Effective STL")
+                                .size() &&
+         strings[2] == "Effective STL" && FrontCodedStrings().empty();
+}
+
+static_assert(test_books());
+
+// the bytes of "é" are negative as (signed) chars
+consteval auto test_utf8() -> bool {
+  auto titles = std::to_array<std::string_view>({"az", "a\xC3\xA9", "\xC3"});
+  auto strings = FrontCodedStrings(titles, 2);
+  return std::ranges::equal(strings, titles) && strings.contains("a\xC3\xA9") &&
+         strings.lower_bound("b") == 2;
+}
+
+static_assert(test_utf8());
+
+} // namespace front_coded_test
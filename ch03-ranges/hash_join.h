@@ -0,0 +1,349 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <ranges>
+#include <stdexcept>
+#include <vector>
+
+#include "parallel.h"
+#include "string_hash.h"
+#include "version.h"
+
+/*
+ * Matching two lists by a key (e.g. reconciling the titles of two feeds): all
+ * the pairs of rows, one from each list, with equal keys. Nested loops cost
+ * O(n * m), sorting both lists O(n log n + m log m); a hash join costs
+ * expected O(n + m):
+ * - the build phase puts the rows of the smaller list into a hash table,
+ * - the probe phase looks up every row of the other list in the table.
+ *
+ * The table is open addressing with linear probing over the row indices; rows
+ * with equal keys share a slot and are chained through a separate array. Every
+ * slot holds the upper bits of the hash as a tag, so keys are only compared on
+ * (almost certain) matches.
+ *
+ * Probing is done in batches: first the slots of the whole batch are
+ * prefetched, then the batch is looked up. With a table larger than the cache,
+ * every lookup is a cache miss, and this way the misses of a batch overlap
+ * instead of being waited for one by one.
+ *
+ * The result is the list of matching (build index, probe index) pairs, no
+ * matter which of the lists the table was built for. The indices are 32-bit,
+ * like those of argsort (see argsort.h), so hash_join throws
+ * std::length_error for lists of more than 2^32 - 1 rows.
+ */
+struct hash_join_match {
+  std::uint32_t build;
+  std::uint32_t probe;
+
+  friend constexpr auto operator<=>(const hash_join_match &,
+                                    const hash_join_match &) = default;
+};
+
+namespace hash_join_details {
+
+inline auto prefetch([[maybe_unused]] const void *address) -> void {
+#if defined(__GNUC__)
+  __builtin_prefetch(address);
+#endif
+}
+
+/*
+ * Joins the build rows with the given indices against the probe rows with the
+ * given indices, calling emit(build index, probe index) for every match. Both
+ * lists of indices are ascending; the matches come in the order of the probe
+ * rows, and for every probe row in the order of the build rows.
+ */
+template <typename BuildKey, typename ProbeKey, typename BuildIndices,
+          typename ProbeIndices, typename Emit>
+constexpr auto join(BuildKey build_key, const BuildIndices &build,
+                    const std::vector<std::uint64_t> &build_hashes,
+                    ProbeKey probe_key, const ProbeIndices &probe,
+                    const std::vector<std::uint64_t> &probe_hashes, Emit emit)
+    -> void {
+  struct Slot {
+    std::uint32_t tag;
+    // the first build row with the key, as a position in build
+    std::uint32_t head;
+  };
+  constexpr auto empty = ~std::uint32_t{0};
+  // the slots use the lower bits of the hash, the partitions the upper ones
+  auto tag = [](std::uint64_t hash) {
+    return static_cast<std::uint32_t>(hash >> 20);
+  };
+
+  const auto size = static_cast<std::size_t>(std::ranges::size(build));
+  const auto mask = std::bit_ceil(std::max(size * 2, std::size_t{16})) - 1;
+  auto slots = std::vector<Slot>(mask + 1, Slot{0, empty});
+  auto next = std::vector<std::uint32_t>(size, empty);
+
+  // backwards, so that the chains list the rows in ascending order
+  for (auto k = static_cast<std::uint32_t>(size); k-- > 0;) {
+    const auto hash = build_hashes[build[k]];
+    for (auto pos = hash & mask;; pos = (pos + 1) & mask) {
+      auto &slot = slots[pos];
+      if (slot.head == empty) {
+        slot = {tag(hash), k};
+        break;
+      }
+      if (slot.tag == tag(hash) &&
+          build_key(build[slot.head]) == build_key(build[k])) {
+        next[k] = std::exchange(slot.head, k);
+        break;
+      }
+    }
+  }
+
+  constexpr auto batch = std::size_t{16};
+  const auto count = static_cast<std::size_t>(std::ranges::size(probe));
+  for (auto first = std::size_t{0}; first < count; first += batch) {
+    const auto last = std::min(first + batch, count);
+
+    if !consteval {
+      for (auto j = first; j < last; ++j) {
+        prefetch(&slots[probe_hashes[probe[j]] & mask]);
+      }
+    }
+
+    for (auto j = first; j < last; ++j) {
+      const auto index = probe[j];
+      const auto hash = probe_hashes[index];
+      for (auto pos = hash & mask;; pos = (pos + 1) & mask) {
+        const auto &slot = slots[pos];
+        if (slot.head == empty) {
+          break;
+        }
+        if (slot.tag == tag(hash) &&
+            build_key(build[slot.head]) == probe_key(index)) {
+          for (auto k = slot.head; k != empty; k = next[k]) {
+            emit(build[k], index);
+          }
+          break;
+        }
+      }
+    }
+  }
+}
+
+template <typename R, typename Proj, typename Hash>
+constexpr auto hashes_of(const R &range, Proj &proj, Hash &hash)
+    -> std::vector<std::uint64_t> {
+  auto hashes = std::vector<std::uint64_t>();
+  hashes.reserve(std::ranges::size(range));
+  for (const auto &row : range) {
+    hashes.push_back(hash(std::invoke(proj, row)));
+  }
+  return hashes;
+}
+
+template <typename R, typename Proj>
+constexpr auto key_of(const R &range, Proj &proj) {
+  return [&range, &proj](std::uint32_t i) -> decltype(auto) {
+    return std::invoke(proj, std::ranges::begin(range)[i]);
+  };
+}
+
+constexpr auto check_sizes(std::size_t build_size, std::size_t probe_size)
+    -> void {
+  if (std::max(build_size, probe_size) >
+      std::numeric_limits<std::uint32_t>::max()) {
+    throw std::length_error("hash_join: too many rows for 32-bit indices");
+  }
+}
+
+template <typename R> constexpr auto all_indices(const R &range) {
+  return std::views::iota(std::uint32_t{0},
+                          static_cast<std::uint32_t>(std::ranges::size(range)));
+}
+
+} // namespace hash_join_details
+
+/*
+ * The sequential version. The matches come in the order of the rows of the
+ * larger list, and for every such row in the order of the rows of the smaller
+ * one.
+ */
+template <Version version, std::ranges::random_access_range Build,
+          std::ranges::random_access_range Probe,
+          typename Proj = std::identity, typename Hash = key_hash>
+  requires VersionRanges<version>
+constexpr auto hash_join(const Build &build, const Probe &probe,
+                         Proj proj = {}, Hash hash = {})
+    -> std::vector<hash_join_match> {
+  using namespace hash_join_details;
+
+  check_sizes(std::ranges::size(build), std::ranges::size(probe));
+
+  auto matches = std::vector<hash_join_match>();
+  auto build_hashes = hashes_of(build, proj, hash);
+  auto probe_hashes = hashes_of(probe, proj, hash);
+
+  if (std::ranges::size(build) <= std::ranges::size(probe)) {
+    join(key_of(build, proj), all_indices(build), build_hashes,
+         key_of(probe, proj), all_indices(probe), probe_hashes,
+         [&](std::uint32_t b, std::uint32_t p) { matches.push_back({b, p}); });
+  } else {
+    join(key_of(probe, proj), all_indices(probe), probe_hashes,
+         key_of(build, proj), all_indices(build), build_hashes,
+         [&](std::uint32_t p, std::uint32_t b) { matches.push_back({b, p}); });
+  }
+  return matches;
+}
+
+/*
+ * The radix-partitioned parallel version, for lists which don't fit in the
+ * cache. Both lists are partitioned by the upper bits of the hashes (see
+ * parallel_partition), so that equal keys end up in the same partition, and
+ * the partitions are joined independently, every thread taking a range of
+ * them.
+ *
+ * There are enough partitions for the table of every partition to be small
+ * enough for the L2 cache (about 16K rows of the smaller list), so the
+ * lookups mostly hit the cache even with a single thread.
+ *
+ * The matches come grouped by partitions, in no particular order otherwise.
+ */
+template <Version version, std::ranges::random_access_range Build,
+          std::ranges::random_access_range Probe,
+          typename Proj = std::identity, typename Hash = key_hash>
+  requires VersionParallel<version>
+auto hash_join(const Build &build, const Probe &probe, Proj proj = {},
+               Hash hash = {}) -> std::vector<hash_join_match> {
+  using namespace hash_join_details;
+
+  const auto build_size = static_cast<std::size_t>(std::ranges::size(build));
+  const auto probe_size = static_cast<std::size_t>(std::ranges::size(probe));
+  check_sizes(build_size, probe_size);
+
+  const auto rows_per_part = std::size_t{1} << 14;
+  const auto parts =
+      std::bit_ceil(std::min(build_size, probe_size) / rows_per_part);
+  if (parts <= 1) {
+    return hash_join<Version::Ranges>(build, probe, proj, hash);
+  }
+  const auto chunks = chunk_count(build_size + probe_size);
+
+  auto build_hashes = std::vector<std::uint64_t>(build_size);
+  auto probe_hashes = std::vector<std::uint64_t>(probe_size);
+  parallel_chunks(build_size + probe_size, chunks,
+                  [&](std::size_t, std::size_t first, std::size_t last) {
+                    for (auto i = first; i < last; ++i) {
+                      if (i < build_size) {
+                        build_hashes[i] = hash(
+                            std::invoke(proj, std::ranges::begin(build)[i]));
+                      } else {
+                        auto j = i - build_size;
+                        probe_hashes[j] = hash(
+                            std::invoke(proj, std::ranges::begin(probe)[j]));
+                      }
+                    }
+                  });
+
+  const auto shift = 64 - std::countr_zero(parts);
+  auto build_parts = parallel_partition(
+      build_size, parts, chunks,
+      [&](std::size_t i) { return build_hashes[i] >> shift; });
+  auto probe_parts = parallel_partition(
+      probe_size, parts, chunks,
+      [&](std::size_t i) { return probe_hashes[i] >> shift; });
+
+  auto results = std::vector<std::vector<hash_join_match>>(parts);
+  parallel_chunks(
+      parts, chunks, [&](std::size_t, std::size_t first, std::size_t last) {
+        for (auto p = first; p < last; ++p) {
+          auto &matches = results[p];
+          if (build_parts[p].size() <= probe_parts[p].size()) {
+            join(key_of(build, proj), build_parts[p], build_hashes,
+                 key_of(probe, proj), probe_parts[p], probe_hashes,
+                 [&](std::uint32_t b, std::uint32_t q) {
+                   matches.push_back({b, q});
+                 });
+          } else {
+            join(key_of(probe, proj), probe_parts[p], probe_hashes,
+                 key_of(build, proj), build_parts[p], build_hashes,
+                 [&](std::uint32_t q, std::uint32_t b) {
+                   matches.push_back({b, q});
+                 });
+          }
+        }
+      });
+
+  auto total = std::size_t{0};
+  for (const auto &matches : results) {
+    total += matches.size();
+  }
+  auto matches = std::vector<hash_join_match>();
+  matches.reserve(total);
+  for (const auto &part : results) {
+    matches.insert(matches.end(), part.begin(), part.end());
+  }
+  return matches;
+}
+
+/*
+ * Compile-time tests (the parallel version uses threads and is runtime-only)
+ */
+namespace hash_join_test {
+
+struct Listing {
+  std::string_view title;
+  int price;
+};
+
+constexpr auto catalog = std::to_array<std::string_view>({
+    "Effective C++",
+    "Exceptional C++",
+    "Effective C++",
+    "C++ Templates",
+});
+
+constexpr auto feed = std::to_array<Listing>({
+    {"C++ Templates", 60},
+    {"Effective C++", 40},
+    {"The C++ Programming Language", 70},
+    {"Effective C++", 35},
+    {"Exceptional C++", 45},
+    {"C++ Templates", 55},
+});
+
+consteval auto test() -> bool {
+  // the table is built for the catalog (the smaller list)
+  auto matches = hash_join<Version::Ranges>(
+      catalog, feed | std::views::transform(&Listing::title));
+
+  // the same, with the table built for the feed
+  auto flipped = hash_join<Version::Ranges>(
+      feed | std::views::transform(&Listing::title), catalog);
+
+  return std::ranges::equal(matches,
+                            std::to_array<hash_join_match>({
+                                {3, 0},
+                                {0, 1},
+                                {2, 1},
+                                {0, 3},
+                                {2, 3},
+                                {1, 4},
+                                {3, 5},
+                            })) &&
+         std::ranges::equal(flipped,
+                            std::to_array<hash_join_match>({
+                                {0, 3},
+                                {1, 0},
+                                {1, 2},
+                                {3, 0},
+                                {3, 2},
+                                {4, 1},
+                                {5, 3},
+                            })) &&
+         hash_join<Version::Ranges>(catalog, std::array<std::string_view, 0>{})
+             .empty();
+}
+
+static_assert(test());
+
+} // namespace hash_join_test
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "runtime_check.h"
+#include "sort_books.h"
+#include "string_hash.h"
+#include "strings_equal.h"
+#include "version.h"
+
+/*
+ * A string which carries its hash along. The hash is computed once, by the
+ * constructor, and then:
+ * - operator== compares the sizes and the hashes first, so two different
+ *   strings are almost always told apart without reading their bytes (which
+ *   matters for long strings which often share a prefix, and for strings
+ *   which aren't in the cache); only equal hashes lead to a byte compare,
+ * - hash containers reuse the stored hash instead of rehashing the bytes on
+ *   every lookup (both std::hash and key_hash from string_hash.h).
+ *
+ * The stored hash is hash_bytes() of the contents, so a plain string_view
+ * hashes the same with key_hash, and can be looked up in a transparent hash
+ * container of hashed strings without being converted first.
+ *
+ * basic_hashed_string is a range of chars, so it's also usable as a Book
+ * title. It comes in two flavours: hashed_string owns the characters,
+ * hashed_string_view doesn't.
+ *
+ * The hash function is a parameter only so that the tests can force
+ * collisions; with another one than hash_contents, plain string_views no
+ * longer hash the same.
+ */
+struct hash_contents {
+  constexpr auto operator()(std::string_view str) const -> std::uint64_t {
+    return hash_bytes(str);
+  }
+};
+
+template <typename String, typename Hash = hash_contents>
+class basic_hashed_string {
+  String str_{};
+  std::uint64_t hash_ = Hash()({});
+
+public:
+  basic_hashed_string() = default;
+
+  constexpr explicit basic_hashed_string(String str)
+      : str_(std::move(str)), hash_(Hash()(str_)) {}
+
+  // literals need no explicit conversion
+  constexpr basic_hashed_string(const char *str)
+      : basic_hashed_string(String(str)) {}
+
+  constexpr auto hash() const -> std::uint64_t { return hash_; }
+  constexpr auto str() const -> const String & { return str_; }
+  constexpr auto view() const -> std::string_view { return str_; }
+  constexpr operator std::string_view() const { return str_; }
+
+  constexpr auto size() const -> std::size_t { return str_.size(); }
+  constexpr auto empty() const -> bool { return str_.empty(); }
+  constexpr auto begin() const { return std::ranges::begin(str_); }
+  constexpr auto end() const { return std::ranges::end(str_); }
+
+  template <typename Other>
+  friend constexpr auto operator==(const basic_hashed_string &lhs,
+                                   const basic_hashed_string<Other, Hash> &rhs)
+      -> bool {
+    return lhs.hash() == rhs.hash() &&
+           strings_equal<Version::Simd>(lhs.view(), rhs.view());
+  }
+
+  // without a hash on the other side, at least the sizes are compared first
+  friend constexpr auto operator==(const basic_hashed_string &lhs,
+                                   std::string_view rhs) -> bool {
+    return strings_equal<Version::Simd>(lhs.view(), rhs);
+  }
+
+  // the hashes don't help with the order, it's the order of the strings
+  template <typename Other>
+  friend constexpr auto operator<=>(const basic_hashed_string &lhs,
+                                    const basic_hashed_string<Other, Hash> &rhs)
+      -> std::strong_ordering {
+    return lhs.view() <=> rhs.view();
+  }
+};
+
+using hashed_string = basic_hashed_string<std::string>;
+using hashed_string_view = basic_hashed_string<std::string_view>;
+
+template <typename String, typename Hash>
+struct std::hash<basic_hashed_string<String, Hash>> {
+  constexpr auto operator()(const basic_hashed_string<String, Hash> &str) const
+      -> std::size_t {
+    return static_cast<std::size_t>(str.hash());
+  }
+};
+
+/*
+ * Compile-time tests
+ */
+namespace hashed_string_test {
+
+// the owning flavour is left out, as std::string has its limitations at
+// compile time (see sort_books.h), but it's the same code
+
+static_assert(StringConcept<hashed_string>);
+static_assert(StringConcept<hashed_string_view>);
+static_assert(std::regular<hashed_string_view>);
+
+constexpr auto effective = hashed_string_view("Effective C++");
+
+static_assert(effective == hashed_string_view("Effective C++"));
+static_assert(effective != hashed_string_view("Effective C+-"));
+static_assert(effective == std::string_view("Effective C++"));
+static_assert(hashed_string_view() == hashed_string_view(""));
+
+// the stored hash is the one of the contents, and it's reused by key_hash
+static_assert(effective.hash() == hash_bytes("Effective C++"));
+static_assert(key_hash()(effective) == effective.hash());
+static_assert(key_hash()(effective) ==
+              key_hash()(std::string_view("Effective C++")));
+
+static_assert(hashed_string_view("a") < hashed_string_view("b"));
+
+consteval auto test_books() -> bool {
+  using Book = Book<hashed_string_view>;
+
+  auto books = std::to_array<Book>({
+      {"Functional programming in C++", "978-3-20-148410-0"},
+      {"Effective C++", "978-3-16-148410-0"},
+  });
+  sort<Version::Ranges>(books);
+  return books[0].title == effective;
+}
+
+static_assert(test_books());
+
+} // namespace hashed_string_test
+
+/*
+ * Runtime test (the owning flavour, and the SIMD compare behind the hashes),
+ * run by ch03-differential: with a hash which always collides, only the
+ * string compare tells the strings apart.
+ */
+inline void hashed_string_collision_test() {
+  struct collide {
+    constexpr auto operator()(std::string_view) const -> std::uint64_t {
+      return 42;
+    }
+  };
+  using colliding_string = basic_hashed_string<std::string, collide>;
+
+  const auto title = std::string("Functional programming in C++, 2nd edition");
+  auto other = title;
+  other[30] = 'X';
+
+  auto lhs = colliding_string(title);
+  runtime_check(lhs.hash() == colliding_string(other).hash());
+  runtime_check(lhs != colliding_string(other));
+  runtime_check(lhs != colliding_string(title.substr(1)));
+  runtime_check(lhs == colliding_string(title));
+
+  // and with the real hash, through both operators
+  auto hashed = hashed_string(title);
+  runtime_check(hashed == hashed_string(title));
+  runtime_check(hashed != hashed_string(other));
+  runtime_check(hashed == hashed_string_view(title));
+  runtime_check(hashed != std::string_view(other));
+}
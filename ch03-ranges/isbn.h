@@ -0,0 +1,310 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "sort_books.h"
+#include "string_hash.h"
+#include "version.h"
+
+/*
+ * ISBN-13 packed into a single integer.
+ *
+ * As a string, "978-3-16-148410-0" takes 17 bytes plus the string object itself
+ * (32 bytes for std::string), and comparing two of them is a loop. As a number,
+ * it takes 8 bytes, and comparisons are single instructions. Since all ISBN-13's
+ * have exactly 13 digits, comparing the numbers gives the same order as
+ * comparing the digit strings.
+ *
+ * Hyphens carry no information (their positions are defined by the registration
+ * groups), so we drop them while parsing and print plain 13 digits back.
+ */
+class Isbn {
+  std::uint64_t value_ = 0;
+
+  constexpr explicit Isbn(std::uint64_t value) : value_(value) {}
+
+public:
+  constexpr static std::size_t digit_count = 13;
+  // 13 digits and at most 4 hyphens between the 5 parts
+  constexpr static std::size_t max_length = digit_count + 4;
+
+  Isbn() = default;
+
+  /*
+   * Parses and validates the string: only digits and hyphens are allowed,
+   * hyphens only between digits, exactly 13 digits, and the last one must be a
+   * correct check digit.
+   */
+  constexpr static auto parse(std::string_view str) -> std::optional<Isbn>;
+
+  /*
+   * The same with a given implementation: Version::Simd is the vectorized one
+   * (at runtime, with SSE2), which parse uses; any other version is the
+   * scalar one. For the differential tests (see differential.cpp).
+   */
+  template <Version version>
+  constexpr static auto parse(std::string_view str) -> std::optional<Isbn>;
+
+  // the value is the 13 digits read as a decimal number
+  constexpr auto value() const -> std::uint64_t { return value_; }
+
+  constexpr auto digits() const -> std::array<char, digit_count> {
+    auto result = std::array<char, digit_count>();
+    auto value = value_;
+    for (auto it = result.rbegin(); it != result.rend(); ++it) {
+      *it = static_cast<char>('0' + value % 10);
+      value /= 10;
+    }
+    return result;
+  }
+
+  constexpr auto to_string() const -> std::string {
+    auto chars = digits();
+    return {chars.begin(), chars.end()};
+  }
+
+  // the compiler generates everything member-wise, which is exactly what we
+  // want for a single integer
+  constexpr auto operator<=>(const Isbn &) const = default;
+
+private:
+  struct Digits {
+    std::array<std::uint8_t, digit_count> values;
+  };
+
+  constexpr static auto parse_scalar(std::string_view str)
+      -> std::optional<Digits>;
+  static auto parse_simd(std::string_view str) -> std::optional<Digits>;
+
+  constexpr static auto from_digits(const Digits &digits)
+      -> std::optional<Isbn>;
+};
+
+/*
+ * The straightforward version, also used at compile time.
+ */
+constexpr auto Isbn::parse_scalar(std::string_view str)
+    -> std::optional<Digits> {
+  if (str.size() > max_length) {
+    return std::nullopt;
+  }
+
+  auto digits = Digits();
+  auto count = std::size_t{0};
+  auto prev_hyphen = true; // no hyphen at the very beginning
+
+  for (auto c : str) {
+    if (c == '-') {
+      if (prev_hyphen) {
+        return std::nullopt;
+      }
+      prev_hyphen = true;
+    } else if (c >= '0' && c <= '9' && count < digit_count) {
+      digits.values[count++] = static_cast<std::uint8_t>(c - '0');
+      prev_hyphen = false;
+    } else {
+      return std::nullopt;
+    }
+  }
+
+  if (prev_hyphen || count != digit_count) {
+    return std::nullopt;
+  }
+
+  return digits;
+}
+
+/*
+ * The vectorized version. Instead of checking the characters one by one, we
+ * classify all of them at once with SSE2 compares, and get a bit per character
+ * with movemask. The whole validation becomes a few bit tricks on two masks:
+ * - every character is a digit or a hyphen,
+ * - no hyphen at the first and last position, and no two hyphens in a row,
+ * - exactly 13 digits.
+ *
+ * Then the digits are gathered by walking the bits of the digit mask.
+ *
+ * The string is copied into a zero-padded buffer first, so the vector loads
+ * never read past its end.
+ */
+inline auto Isbn::parse_simd(std::string_view str) -> std::optional<Digits> {
+#if defined(__SSE2__)
+  if (str.empty() || str.size() > max_length) {
+    return std::nullopt;
+  }
+
+  alignas(16) char buffer[32] = {};
+  std::ranges::copy(str, buffer);
+
+  auto classify = [](const char *ptr, std::uint32_t &digit_mask,
+                     std::uint32_t &hyphen_mask, int shift) {
+    auto chars = _mm_load_si128(reinterpret_cast<const __m128i *>(ptr));
+    // c - '0' as signed bytes is in [0, 9] for digits only; we check that with
+    // two signed compares, since SSE2 has no unsigned byte compares
+    auto shifted = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+    auto digits =
+        _mm_andnot_si128(_mm_cmplt_epi8(shifted, _mm_setzero_si128()),
+                         _mm_cmplt_epi8(shifted, _mm_set1_epi8(10)));
+    auto hyphens = _mm_cmpeq_epi8(chars, _mm_set1_epi8('-'));
+
+    digit_mask |= static_cast<std::uint32_t>(_mm_movemask_epi8(digits))
+                  << shift;
+    hyphen_mask |= static_cast<std::uint32_t>(_mm_movemask_epi8(hyphens))
+                   << shift;
+  };
+
+  auto digit_mask = std::uint32_t{0};
+  auto hyphen_mask = std::uint32_t{0};
+  classify(buffer, digit_mask, hyphen_mask, 0);
+  classify(buffer + 16, digit_mask, hyphen_mask, 16);
+
+  const auto size = static_cast<std::uint32_t>(str.size());
+  const auto all = (std::uint32_t{1} << size) - 1;
+  const auto last = std::uint32_t{1} << (size - 1);
+
+  if ((digit_mask | hyphen_mask) != all ||
+      (hyphen_mask & (1 | last | (hyphen_mask >> 1))) != 0 ||
+      std::popcount(digit_mask) != digit_count) {
+    return std::nullopt;
+  }
+
+  auto digits = Digits();
+  for (auto &digit : digits.values) {
+    auto pos = std::countr_zero(digit_mask);
+    digit = static_cast<std::uint8_t>(buffer[pos] - '0');
+    digit_mask &= digit_mask - 1; // clear the lowest bit
+  }
+
+  return digits;
+#else
+  return parse_scalar(str);
+#endif
+}
+
+constexpr auto Isbn::from_digits(const Digits &digits) -> std::optional<Isbn> {
+  // the check digit makes the weighted sum (weights 1, 3, 1, 3, ...) of all
+  // the 13 digits divisible by 10
+  auto value = std::uint64_t{0};
+  auto sum = 0u;
+  for (auto i = std::size_t{0}; i < digit_count; ++i) {
+    value = value * 10 + digits.values[i];
+    sum += digits.values[i] * (i % 2 == 0 ? 1u : 3u);
+  }
+
+  if (sum % 10 != 0) {
+    return std::nullopt;
+  }
+
+  return Isbn(value);
+}
+
+template <Version version>
+constexpr auto Isbn::parse(std::string_view str) -> std::optional<Isbn> {
+  // C++23 if consteval: intrinsics aren't usable at compile time, so we take
+  // the scalar path there
+  auto digits = std::optional<Digits>();
+  if consteval {
+    digits = parse_scalar(str);
+  } else {
+    if constexpr (VersionSimd<version>) {
+      digits = parse_simd(str);
+    } else {
+      digits = parse_scalar(str);
+    }
+  }
+
+  if (!digits) {
+    return std::nullopt;
+  }
+  return from_digits(*digits);
+}
+
+constexpr auto Isbn::parse(std::string_view str) -> std::optional<Isbn> {
+  return parse<Version::Simd>(str);
+}
+
+/*
+ * The value itself is unique, but ISBNs share their leading digits and differ
+ * mostly in the low ones, which is bad for hash tables that take the low bits
+ * of the hash. So we mix the bits with the splitmix64 finalizer (mix64, see
+ * string_hash.h).
+ */
+template <> struct std::hash<Isbn> {
+  constexpr auto operator()(const Isbn &isbn) const noexcept -> std::size_t {
+    return static_cast<std::size_t>(mix64(isbn.value()));
+  }
+};
+
+/*
+ * A literal for ISBNs known at compile time; an invalid one is a compile error,
+ * since throwing isn't allowed in constant evaluation.
+ */
+namespace isbn_literals {
+consteval auto operator""_isbn(const char *str, std::size_t size) -> Isbn {
+  auto isbn = Isbn::parse({str, size});
+  if (!isbn) {
+    throw std::invalid_argument("invalid ISBN-13");
+  }
+  return *isbn;
+}
+} // namespace isbn_literals
+
+/*
+ * Compile-time tests
+ */
+namespace isbn_test {
+
+using namespace isbn_literals;
+
+static_assert(sizeof(Isbn) == sizeof(std::uint64_t));
+
+static_assert(Isbn::parse("978-3-16-148410-0"));
+static_assert(Isbn::parse("9783161484100"));
+static_assert(Isbn::parse("978-3-16-148410-0") == Isbn::parse("9783161484100"));
+static_assert("978-3-16-148410-0"_isbn.value() == 9783161484100);
+
+// wrong check digit
+static_assert(!Isbn::parse("978-3-16-148410-1"));
+// misplaced hyphens
+static_assert(!Isbn::parse("-978-3-16-148410-0"));
+static_assert(!Isbn::parse("978-3-16-148410-0-"));
+static_assert(!Isbn::parse("978--3-16-148410-0"));
+// wrong digit count and characters
+static_assert(!Isbn::parse("978-3-16-14841-0"));
+static_assert(!Isbn::parse("978-3-16-1484100-0"));
+static_assert(!Isbn::parse("9-7-8-3-1-6-148410-0"));
+static_assert(!Isbn::parse("978 3 16 148410 0"));
+static_assert(!Isbn::parse(""));
+
+static_assert("978-0-32-133487-9"_isbn < "978-3-16-148410-0"_isbn);
+
+static_assert(Isbn::parse<Version::Iterator>("978-3-16-148410-0") ==
+              Isbn::parse("978-3-16-148410-0"));
+
+consteval auto test_digits() -> bool {
+  auto digits = "978-3-16-148410-0"_isbn.digits();
+  return std::string_view(digits.data(), digits.size()) == "9783161484100";
+}
+static_assert(test_digits());
+
+// Book works with the packed isbn the same way as with strings
+using PackedBook = Book<std::string_view, Isbn>;
+static_assert(BookConcept<PackedBook>);
+static_assert(PackedBook{"Effective C++", "978-0-32-133487-9"_isbn} ==
+              PackedBook{"Effective C++", "978-0-32-133487-9"_isbn});
+static_assert(sizeof(PackedBook) < sizeof(Book<std::string_view>));
+
+} // namespace isbn_test
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/*
+ * Tournament tree of losers, the classical structure for k-way merging.
+ *
+ * The tree is played between k sources (runs, files, ranges, ...), and it only
+ * deals with their indices: the caller provides less(i, j), telling if the
+ * current element of source i goes before the current element of source j,
+ * where exhausted sources should go after everything else.
+ *
+ * Every internal node remembers the loser of the match played in it, and the
+ * overall winner is kept separately. When the winner's source advances, the
+ * new element only has to replay the matches on the path from its leaf to the
+ * root, against the losers stored there: exactly one comparison per level, so
+ * log2(k) comparisons per element (ties are broken by the source index, not
+ * by a second comparison). A plain binary heap needs up to twice as many, as
+ * it compares against both children on the way down.
+ *
+ * Equal elements are taken from the source with the smaller index first, which
+ * makes the merge stable.
+ */
+template <typename Less> class loser_tree {
+  std::size_t k_;
+  // tree_[0] is the winner, tree_[1..k) are the losers of the internal nodes;
+  // the leaves (k..2k) are implicit: leaf k + i is source i
+  std::vector<std::size_t> tree_;
+  Less less_;
+
+public:
+  constexpr loser_tree(std::size_t k, Less less)
+      : k_(k), tree_(std::max(k, std::size_t{1})), less_(std::move(less)) {
+    tree_[0] = k_ > 1 ? play(1) : 0;
+  }
+
+  // the source holding the smallest current element
+  constexpr auto top() const -> std::size_t { return tree_[0]; }
+
+  // to be called after the top source has advanced (or got exhausted)
+  constexpr auto replay() -> void {
+    auto winner = tree_[0];
+    for (auto node = (winner + k_) / 2; node > 0; node /= 2) {
+      if (beats(tree_[node], winner)) {
+        std::swap(tree_[node], winner);
+      }
+    }
+    tree_[0] = winner;
+  }
+
+private:
+  // a single comparison: the source with the smaller index wins unless the
+  // other one is strictly less, which breaks the ties by index
+  constexpr auto beats(std::size_t lhs, std::size_t rhs) -> bool {
+    return lhs < rhs ? !less_(rhs, lhs) : less_(lhs, rhs);
+  }
+
+  // plays the initial tournament for the subtree, returns its winner
+  constexpr auto play(std::size_t node) -> std::size_t {
+    if (node >= k_) {
+      return node - k_;
+    }
+
+    auto lhs = play(2 * node);
+    auto rhs = play(2 * node + 1);
+    if (beats(lhs, rhs)) {
+      tree_[node] = rhs;
+      return lhs;
+    }
+    tree_[node] = lhs;
+    return rhs;
+  }
+};
+
+/*
+ * Compile-time tests
+ */
+namespace loser_tree_test {
+
+template <std::size_t k>
+consteval auto merge(std::array<std::vector<int>, k> sources)
+    -> std::vector<int> {
+  auto pos = std::array<std::size_t, k>{};
+  auto exhausted = [&](std::size_t i) { return pos[i] == sources[i].size(); };
+  auto less = [&](std::size_t i, std::size_t j) {
+    if (exhausted(i) || exhausted(j)) {
+      return !exhausted(i) && exhausted(j);
+    }
+    return sources[i][pos[i]] < sources[j][pos[j]];
+  };
+
+  auto tree = loser_tree(k, less);
+  auto result = std::vector<int>();
+  while (!exhausted(tree.top())) {
+    result.push_back(sources[tree.top()][pos[tree.top()]++]);
+    tree.replay();
+  }
+  return result;
+}
+
+consteval auto test() -> bool {
+  return std::ranges::equal(
+             merge<3>({{{1, 4, 7}, {2, 5, 8}, {0, 3, 6, 9}}}),
+             std::array{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}) &&
+         std::ranges::equal(merge<1>({{{1, 2}}}), std::array{1, 2}) &&
+         std::ranges::equal(merge<5>({{{5}, {}, {1, 1}, {3}, {0, 9}}}),
+                            std::array{0, 1, 1, 3, 5, 9});
+}
+
+static_assert(test());
+
+// k - 1 comparisons for the initial tournament, then one per level and element
+consteval auto test_comparisons() -> bool {
+  auto sources = std::array<std::vector<int>, 4>{
+      {{1, 1, 5}, {1, 2, 6}, {0, 1, 7}, {3, 4, 8}}};
+  auto pos = std::array<std::size_t, 4>{};
+  auto comparisons = std::size_t{0};
+  auto less = [&](std::size_t i, std::size_t j) {
+    ++comparisons;
+    if (pos[i] == sources[i].size() || pos[j] == sources[j].size()) {
+      return pos[i] != sources[i].size() && pos[j] == sources[j].size();
+    }
+    return sources[i][pos[i]] < sources[j][pos[j]];
+  };
+
+  auto tree = loser_tree(4, less);
+  for (auto i = 0; i < 12; ++i) {
+    ++pos[tree.top()];
+    tree.replay();
+  }
+  return comparisons == 3 + 12 * 2;
+}
+
+static_assert(test_comparisons());
+
+} // namespace loser_tree_test
@@ -1,11 +1,33 @@
+#include "argsort.h"
+#include "autotuner.h"
+#include "book_catalog.h"
+#include "collation.h"
+#include "columnar_catalog.h"
 #include "custom_adaptor.h"
 #include "custom_take_view.h"
+#include "dedupe_books.h"
+#include "external_sort_books.h"
+#include "fast_paths.h"
+#include "front_coded.h"
+#include "hash_join.h"
+#include "hashed_string.h"
+#include "isbn.h"
+#include "loser_tree.h"
+#include "merge_books.h"
 #include "odd_numbers.h"
+#include "parallel.h"
 #include "range.h"
 #include "range_algorithm_overview.h"
 #include "ranges_concepts.h"
+#include "snapshot_catalog.h"
 #include "sort_books.h"
+#include "sorted_catalog.h"
+#include "static_catalog.h"
+#include "string_hash.h"
+#include "string_set_matcher.h"
 #include "strings_equal.h"
+#include "title_index.h"
+#include "top_k_books.h"
 #include "uniform_begin.h"
 
 int main(int argc, char *argv[]) { return 0; }
@@ -0,0 +1,319 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "loser_tree.h"
+#include "parallel.h"
+#include "sort_books.h"
+#include "version.h"
+
+/*
+ * Merging k catalogs, each of them already sorted by the projection (the title
+ * by default). Concatenating them and running sort<version> would cost
+ * O(n log n) and ignore the existing order; a k-way merge with a loser tree
+ * (see loser_tree.h) costs O(n log k), with one comparison per tree level.
+ *
+ * The merge is stable: books with equal keys come in the order of the inputs,
+ * and within an input, in their original order.
+ */
+template <typename T>
+concept RangeOfBooksConcept =
+    std::ranges::forward_range<T> &&
+    BooksConcept<std::ranges::range_value_t<T>> &&
+    std::ranges::forward_range<std::ranges::range_value_t<T>>;
+
+namespace merge_details {
+
+template <typename Ranges>
+using BookOf = std::ranges::range_value_t<std::ranges::range_value_t<Ranges>>;
+
+template <typename Ranges>
+using InputOf = std::ranges::subrange<std::ranges::iterator_t<
+    const std::ranges::range_value_t<Ranges>>>;
+
+template <typename Ranges>
+using TitleProj = decltype(&BookOf<Ranges>::title);
+
+/*
+ * The merge state: the unconsumed parts of all the inputs, and the tree.
+ * Everything the tree compares is referenced by index, so the state is kept
+ * at a stable address (the comparator points to it).
+ */
+template <typename Input, typename Proj> class MergeState {
+  std::vector<Input> inputs_;
+  Proj proj_;
+
+  struct Less {
+    const MergeState *state;
+    constexpr auto operator()(std::size_t i, std::size_t j) const -> bool {
+      const auto &lhs = state->inputs_[i];
+      const auto &rhs = state->inputs_[j];
+      if (lhs.empty() || rhs.empty()) {
+        return !lhs.empty() && rhs.empty();
+      }
+      return std::invoke(state->proj_, lhs.front()) <
+             std::invoke(state->proj_, rhs.front());
+    }
+  };
+
+  loser_tree<Less> tree_;
+
+public:
+  constexpr MergeState(std::vector<Input> inputs, Proj proj)
+      : inputs_(std::move(inputs)), proj_(std::move(proj)),
+        tree_(inputs_.size(), Less{this}) {}
+
+  MergeState(const MergeState &) = delete;
+  MergeState &operator=(const MergeState &) = delete;
+
+  constexpr auto done() const -> bool {
+    return inputs_.empty() || inputs_[tree_.top()].empty();
+  }
+
+  constexpr auto top() const -> decltype(auto) {
+    return inputs_[tree_.top()].front();
+  }
+
+  constexpr auto pop() -> void {
+    inputs_[tree_.top()].advance(1);
+    tree_.replay();
+  }
+};
+
+// merges the given slices of the inputs into the output iterator
+template <typename Input, typename Proj, typename Out>
+constexpr auto merge_into(std::vector<Input> inputs, Proj proj, Out out)
+    -> Out {
+  auto state = MergeState<Input, Proj>(std::move(inputs), std::move(proj));
+  for (; !state.done(); state.pop()) {
+    *out = state.top();
+    ++out;
+  }
+  return out;
+}
+
+template <RangeOfBooksConcept Ranges>
+constexpr auto inputs_of(const Ranges &ranges) -> std::vector<InputOf<Ranges>> {
+  auto inputs = std::vector<InputOf<Ranges>>();
+  for (const auto &range : ranges) {
+    inputs.emplace_back(std::ranges::begin(range), std::ranges::end(range));
+  }
+  return inputs;
+}
+
+} // namespace merge_details
+
+template <Version version, RangeOfBooksConcept Ranges,
+          typename Proj = merge_details::TitleProj<Ranges>>
+  requires VersionRanges<version>
+constexpr auto merge_sorted(const Ranges &ranges,
+                            Proj proj = &merge_details::BookOf<Ranges>::title) {
+  using namespace merge_details;
+
+  auto result = std::vector<BookOf<Ranges>>();
+  merge_into(inputs_of(ranges), proj, std::back_inserter(result));
+  return result;
+}
+
+/*
+ * The parallel version splits the output into parts, one per thread, which are
+ * merged independently and then concatenated.
+ *
+ * The splitters are keys sampled at even distances from the longest input.
+ * Every input is cut at the lower bound of every splitter (binary search), so
+ * part p gets the books with keys in [splitter p - 1, splitter p) from all the
+ * inputs. The cut positions also give the size of every part. With
+ * many duplicate keys the parts can get uneven, but the result is the same as
+ * with the sequential version.
+ */
+template <Version version, RangeOfBooksConcept Ranges,
+          typename Proj = merge_details::TitleProj<Ranges>>
+  requires VersionParallel<version> &&
+           std::ranges::random_access_range<std::ranges::range_value_t<Ranges>>
+auto merge_sorted(const Ranges &ranges,
+                  Proj proj = &merge_details::BookOf<Ranges>::title) {
+  using namespace merge_details;
+  using Input = InputOf<Ranges>;
+
+  auto inputs = inputs_of(ranges);
+
+  auto total = std::size_t{0};
+  for (const auto &input : inputs) {
+    total += input.size();
+  }
+
+  const auto parts = chunk_count(total);
+  if (parts == 1 || inputs.empty()) {
+    return merge_sorted<Version::Ranges>(ranges, proj);
+  }
+
+  const auto &longest = *std::ranges::max_element(inputs, {}, &Input::size);
+
+  // cuts[p][i] is where part p starts in input i
+  auto cuts = std::vector<std::vector<std::size_t>>(parts + 1);
+  auto offsets = std::vector<std::size_t>(parts + 1);
+  for (auto p = std::size_t{0}; p <= parts; ++p) {
+    for (const auto &input : inputs) {
+      if (p == 0) {
+        cuts[p].push_back(0);
+      } else if (p == parts) {
+        cuts[p].push_back(input.size());
+      } else {
+        const auto &splitter =
+            std::invoke(proj, longest[longest.size() * p / parts]);
+        auto it = std::ranges::lower_bound(input, splitter, {}, proj);
+        cuts[p].push_back(static_cast<std::size_t>(it - input.begin()));
+      }
+      offsets[p] += cuts[p].back();
+    }
+  }
+
+  // every part is merged into a vector of its own, which is then moved to
+  // the end of the result: the books are only ever constructed from the
+  // inputs, never default-constructed to be overwritten
+  auto merged = std::vector<std::vector<BookOf<Ranges>>>(parts);
+  parallel_chunks(parts, parts, [&](std::size_t p, std::size_t, std::size_t) {
+    auto slices = std::vector<Input>();
+    for (auto i = std::size_t{0}; i < inputs.size(); ++i) {
+      slices.emplace_back(inputs[i].begin() + cuts[p][i],
+                          inputs[i].begin() + cuts[p + 1][i]);
+    }
+    merged[p].reserve(offsets[p + 1] - offsets[p]);
+    merge_into(std::move(slices), proj, std::back_inserter(merged[p]));
+  });
+
+  auto result = std::vector<BookOf<Ranges>>();
+  result.reserve(total);
+  for (auto &part : merged) {
+    std::ranges::move(part, std::back_inserter(result));
+  }
+  return result;
+}
+
+/*
+ * The lazy form: a view producing the merged books one by one, on demand, so
+ * nothing is materialized (e.g. only the first page of the merged listing can
+ * be taken with std::views::take).
+ *
+ * It's a single-pass input view. The merge state is created by begin() and
+ * owned by the iterator, which is move-only, like iterators of other
+ * single-pass views (e.g. those of coroutine generators).
+ */
+template <typename Input, typename Proj>
+class merge_view
+    : public std::ranges::view_interface<merge_view<Input, Proj>> {
+  using State = merge_details::MergeState<Input, Proj>;
+
+  std::vector<Input> inputs_;
+  Proj proj_;
+
+  class iterator {
+    std::unique_ptr<State> state_;
+
+  public:
+    using value_type = std::ranges::range_value_t<Input>;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+    explicit iterator(std::unique_ptr<State> state)
+        : state_(std::move(state)) {}
+
+    iterator(iterator &&) = default;
+    iterator &operator=(iterator &&) = default;
+
+    auto operator*() const -> std::ranges::range_reference_t<Input> {
+      return state_->top();
+    }
+
+    auto operator++() -> iterator & {
+      state_->pop();
+      return *this;
+    }
+    auto operator++(int) -> void { ++*this; }
+
+    friend auto operator==(const iterator &it, std::default_sentinel_t)
+        -> bool {
+      return it.state_->done();
+    }
+  };
+
+public:
+  merge_view() = default;
+  merge_view(std::vector<Input> inputs, Proj proj)
+      : inputs_(std::move(inputs)), proj_(std::move(proj)) {}
+
+  auto begin() -> iterator {
+    return iterator(std::make_unique<State>(inputs_, proj_));
+  }
+  auto end() const -> std::default_sentinel_t { return {}; }
+};
+
+/*
+ * The view refers to the books of the inputs, so the inputs have to outlive
+ * it: temporaries (e.g. views::merge_sorted(load_shards())) are rejected,
+ * unless they are borrowed ranges, which don't own their elements.
+ */
+namespace views {
+inline constexpr auto merge_sorted =
+    []<typename Ranges,
+       typename Proj = merge_details::TitleProj<std::remove_cvref_t<Ranges>>>(
+        Ranges &&ranges,
+        Proj proj = &merge_details::BookOf<std::remove_cvref_t<Ranges>>::title)
+  requires RangeOfBooksConcept<std::remove_cvref_t<Ranges>> &&
+           (std::is_lvalue_reference_v<Ranges> ||
+            std::ranges::borrowed_range<Ranges>)
+{
+  return merge_view(merge_details::inputs_of(std::as_const(ranges)),
+                    std::move(proj));
+};
+} // namespace views
+
+/*
+ * Compile-time tests (the parallel version and the view are runtime-only, as
+ * they use threads and unique_ptr respectively)
+ */
+namespace merge_books_test {
+
+using Book = Book<std::string_view>;
+
+consteval auto test() -> bool {
+  auto shards = std::vector<std::vector<Book>>{
+      {{"Effective C++", "1"}, {"Exceptional C++", "2"}},
+      {},
+      {{"C++ Concurrency in Action", "3"}, {"Effective C++", "4"}},
+      {{"The C++ Programming Language", "5"}},
+  };
+
+  auto merged = merge_sorted<Version::Ranges>(shards);
+  auto by_isbn = merge_sorted<Version::Ranges>(shards, &Book::isbn);
+
+  return std::ranges::equal(merged, std::array{"3", "1", "4", "2", "5"}, {},
+                            &Book::isbn) &&
+         std::ranges::equal(by_isbn, std::array{"1", "2", "3", "4", "5"}, {},
+                            &Book::isbn) &&
+         merge_sorted<Version::Ranges>(std::vector<std::vector<Book>>{})
+             .empty();
+}
+
+static_assert(test());
+
+static_assert(std::ranges::input_range<
+              merge_view<std::ranges::subrange<const Book *>,
+                         decltype(&Book::title)>>);
+
+using Shards = std::vector<std::vector<Book>>;
+static_assert(std::invocable<decltype(views::merge_sorted), Shards &>);
+static_assert(std::invocable<decltype(views::merge_sorted), const Shards &>);
+static_assert(std::invocable<decltype(views::merge_sorted),
+                             std::span<const std::vector<Book>>>);
+static_assert(!std::invocable<decltype(views::merge_sorted), Shards>);
+
+} // namespace merge_books_test
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/*
+ * A tiny helper for the Version::Parallel implementations: splitting an index
+ * range into chunks and processing every chunk on its own thread.
+ *
+ * C++20 std::jthread joins in its destructor, so there's no way to forget a
+ * join (and leak a running thread) when leaving the scope.
+ */
+
+/*
+ * How many chunks to split the given number of elements into: one per hardware
+ * thread, but we don't spawn threads for less than min_chunk elements each, as
+ * starting a thread costs more than processing a small chunk.
+ */
+inline auto chunk_count(std::size_t size, std::size_t min_chunk = 1 << 14)
+    -> std::size_t {
+  const auto threads = std::max(
+      std::size_t{std::thread::hardware_concurrency()}, std::size_t{1});
+  return std::clamp(size / std::max(min_chunk, std::size_t{1}), std::size_t{1},
+                    threads);
+}
+
+/*
+ * Calls fn(chunk, first, last) for each of the chunks of [0, size), in
+ * parallel. The first chunk is processed on the calling thread. Returns when
+ * all the chunks are done.
+ */
+template <typename Fn>
+auto parallel_chunks(std::size_t size, std::size_t chunks, Fn fn) -> void {
+  auto bounds = [size, chunks](std::size_t chunk) {
+    return size * chunk / chunks;
+  };
+
+  auto threads = std::vector<std::jthread>();
+  threads.reserve(chunks);
+  for (auto chunk = std::size_t{1}; chunk < chunks; ++chunk) {
+    threads.emplace_back(fn, chunk, bounds(chunk), bounds(chunk + 1));
+  }
+
+  fn(std::size_t{0}, bounds(0), bounds(1));
+}
+
+/*
+ * The indices of [0, size), grouped by partitions: partition p is
+ * indices[bounds[p], bounds[p + 1]).
+ */
+struct partitioned_indices {
+  std::vector<std::uint32_t> indices;
+  std::vector<std::size_t> bounds;
+
+  auto size() const -> std::size_t { return bounds.size() - 1; }
+
+  auto operator[](std::size_t p) const -> std::span<const std::uint32_t> {
+    return std::span(indices).subspan(bounds[p], bounds[p + 1] - bounds[p]);
+  }
+};
+
+/*
+ * Groups the indices of [0, size) by partition_of(index), which is less than
+ * parts, with the given number of threads:
+ * 1. every thread counts the indices of its chunk per partition,
+ * 2. the counts give every (chunk, partition) pair its place in the output,
+ * 3. every thread scatters the indices of its chunk there.
+ * So the indices of every partition are still ascending. The indices are
+ * 32-bit, so a size beyond 2^32 - 1 throws std::length_error.
+ */
+template <typename PartitionOf>
+auto parallel_partition(std::size_t size, std::size_t parts,
+                        std::size_t chunks, PartitionOf partition_of)
+    -> partitioned_indices {
+  if (size > std::numeric_limits<std::uint32_t>::max()) {
+    throw std::length_error("parallel_partition: too many indices");
+  }
+
+  // 1. counted locally first, as neighbouring counters would make the
+  // threads fight for the same cache lines
+  auto offsets = std::vector<std::vector<std::size_t>>(chunks);
+  parallel_chunks(size, chunks,
+                  [&](std::size_t chunk, std::size_t first, std::size_t last) {
+                    auto counts = std::vector<std::size_t>(parts);
+                    for (auto i = first; i < last; ++i) {
+                      ++counts[partition_of(i)];
+                    }
+                    offsets[chunk] = std::move(counts);
+                  });
+
+  // 2.
+  auto result = partitioned_indices{std::vector<std::uint32_t>(size),
+                                    std::vector<std::size_t>(parts + 1)};
+  auto offset = std::size_t{0};
+  for (auto p = std::size_t{0}; p < parts; ++p) {
+    result.bounds[p] = offset;
+    for (auto &counts : offsets) {
+      offset += std::exchange(counts[p], offset);
+    }
+  }
+  result.bounds[parts] = offset;
+
+  // 3.
+  parallel_chunks(size, chunks,
+                  [&](std::size_t chunk, std::size_t first, std::size_t last) {
+                    auto &next = offsets[chunk];
+                    for (auto i = first; i < last; ++i) {
+                      result.indices[next[partition_of(i)]++] =
+                          static_cast<std::uint32_t>(i);
+                    }
+                  });
+
+  return result;
+}
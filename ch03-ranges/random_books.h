@@ -0,0 +1,119 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "sort_books.h"
+
+/*
+ * Generated book catalogs, for the benchmarks (bench.cpp, sort_bench.cpp), the
+ * differential tests (differential.cpp) and the autotuner (autotuner.h).
+ *
+ * The titles are sequences of words from a synthetic vocabulary, drawn with a
+ * Zipf distribution (a few words are very common, most are rare, like in real
+ * titles). Some titles start with one of a few common prefixes
+ * ("Introduction to ..."), which makes the comparisons longer.
+ */
+class CatalogGenerator {
+  std::mt19937_64 rng_;
+  std::vector<std::string> words_;
+  std::vector<double> cdf_;
+
+  constexpr static auto prefixes = std::to_array<std::string_view>({
+      "The Art of ",
+      "Introduction to ",
+      "Effective ",
+      "A Practical Guide to ",
+      "Programming ",
+  });
+
+  auto uniform() -> double {
+    return std::uniform_real_distribution<double>(0.0, 1.0)(rng_);
+  }
+
+  auto word() -> const std::string & {
+    auto rank = std::ranges::upper_bound(cdf_, uniform()) - cdf_.begin();
+    return words_[std::min<std::size_t>(rank, words_.size() - 1)];
+  }
+
+public:
+  explicit CatalogGenerator(std::uint64_t seed, std::size_t vocabulary = 5000,
+                            double skew = 1.07)
+      : rng_(seed) {
+    constexpr auto syllables = std::to_array<std::string_view>({
+        "al", "go", "ri", "thm", "da", "ta", "pro", "gram", "ming", "sys",
+        "tem", "de", "sign", "con", "cur", "ren", "cy", "lan", "gua", "ge",
+    });
+    auto pick = std::uniform_int_distribution<std::size_t>(
+        0, syllables.size() - 1);
+    auto count = std::uniform_int_distribution<int>(1, 4);
+
+    auto weights = std::vector<double>();
+    for (auto rank = std::size_t{1}; rank <= vocabulary; ++rank) {
+      auto word = std::string();
+      for (auto i = count(rng_); i > 0; --i) {
+        word += syllables[pick(rng_)];
+      }
+      word[0] = static_cast<char>(word[0] - 'a' + 'A');
+      words_.push_back(std::move(word));
+      weights.push_back(1.0 / std::pow(static_cast<double>(rank), skew));
+    }
+
+    auto total = 0.0;
+    for (auto weight : weights) {
+      total += weight;
+      cdf_.push_back(total);
+    }
+    for (auto &value : cdf_) {
+      value /= total;
+    }
+  }
+
+  auto title() -> std::string {
+    auto title = std::string();
+    if (uniform() < 0.4) {
+      title = prefixes[rng_() % prefixes.size()];
+    }
+    for (auto i = 1 + rng_() % 6; i > 0; --i) {
+      title += word();
+      title += ' ';
+    }
+    title.pop_back();
+    return title;
+  }
+
+  auto index(std::size_t size) -> std::size_t { return rng_() % size; }
+};
+
+/*
+ * A catalog of size books with unique isbns, the same for the same seed. With
+ * titles = 0 every book gets a title of its own (the same titles are rare);
+ * otherwise the books share titles drawn from that many, which is what the
+ * operations looking for equal titles (dedupe, join, stable sorts) need.
+ */
+inline auto random_books(std::uint64_t seed, std::size_t size,
+                         std::size_t titles = 0)
+    -> std::vector<Book<std::string>> {
+  auto generator = CatalogGenerator(seed);
+  auto books = std::vector<Book<std::string>>();
+  books.reserve(size);
+
+  auto vocabulary = std::vector<std::string>();
+  for (auto i = std::size_t{0}; i < titles; ++i) {
+    vocabulary.push_back(generator.title());
+  }
+  for (auto i = std::size_t{0}; i < size; ++i) {
+    auto title = vocabulary.empty()
+                     ? generator.title()
+                     : vocabulary[generator.index(vocabulary.size())];
+    books.push_back({std::move(title), std::to_string(9780000000000 + i)});
+  }
+  return books;
+}
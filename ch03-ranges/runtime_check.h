@@ -0,0 +1,26 @@
+#pragma once
+
+#include <source_location>
+#include <stdexcept>
+#include <string>
+
+#include "temp_file.h"
+
+/*
+ * The checks of the runtime tests (the ones which can't be compile-time tests,
+ * because they write files or start threads). Unlike assert, they don't go
+ * away with NDEBUG, as the tests run in release builds too: the differential
+ * executable runs them (see differential.cpp).
+ *
+ * A failed check throws std::runtime_error, naming where it failed. The files
+ * the tests write are TempFiles (see temp_file.h).
+ */
+inline void runtime_check(
+    bool condition,
+    std::source_location where = std::source_location::current()) {
+  if (!condition) {
+    throw std::runtime_error(std::string("check failed at ") +
+                             where.file_name() + ":" +
+                             std::to_string(where.line()));
+  }
+}
@@ -0,0 +1,274 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "runtime_check.h"
+#include "sort_books.h"
+#include "sorted_catalog.h"
+
+/*
+ * A catalog shared between reader threads answering queries and a writer
+ * thread which periodically updates (merges, resorts) it, RCU-style
+ * (read-copy-update):
+ * - the catalog is never changed in place; every update builds a new sorted
+ *   generation aside, and publishes it with a single atomic pointer exchange,
+ * - readers take a snapshot, an immutable generation, without taking any
+ *   locks; a snapshot stays valid and unchanged for as long as it's held, even
+ *   if newer generations get published in the meantime,
+ * - old generations are reclaimed once no reader holds them.
+ *
+ * So a long resort never blocks the readers: they keep reading the previous
+ * generation until the new one is ready.
+ *
+ * The readers announce which generation they're reading with hazard pointers:
+ * every reader owns a slot, and stores the generation pointer there before
+ * using it. The writer frees a retired generation only if it isn't in any of
+ * the slots. Taking a snapshot is a handful of atomic operations; readers
+ * never wait for the writer, and the writers only wait for each other.
+ */
+template <BookConcept BookType, auto proj = &BookType::title>
+class SnapshotCatalog {
+public:
+  using Catalog = SortedCatalog<BookType, proj>;
+
+private:
+  struct Generation {
+    Catalog catalog;
+    std::uint64_t number;
+  };
+
+  // one per cache line, so that readers don't slow each other down
+  struct alignas(64) HazardSlot {
+    std::atomic<const Generation *> hazard{nullptr};
+  };
+
+  std::atomic<const Generation *> current_;
+  std::vector<HazardSlot> slots_;
+
+  std::mutex writer_;
+  std::vector<const Generation *> retired_;
+
+  auto claim(const Generation *generation) -> HazardSlot & {
+    // threads start at different slots, so they rarely compete for the same
+    const auto start = std::hash<std::thread::id>()(std::this_thread::get_id());
+    for (auto i = std::size_t{0}; i < slots_.size(); ++i) {
+      auto &slot = slots_[(start + i) % slots_.size()];
+      auto expected = static_cast<const Generation *>(nullptr);
+      if (slot.hazard.compare_exchange_strong(expected, generation)) {
+        return slot;
+      }
+    }
+    throw std::length_error("SnapshotCatalog: too many snapshots at once");
+  }
+
+  // frees the retired generations no reader holds; with the writer_ locked
+  auto reclaim() -> void {
+    auto held = std::vector<const Generation *>();
+    for (const auto &slot : slots_) {
+      if (auto hazard = slot.hazard.load(); hazard) {
+        held.push_back(hazard);
+      }
+    }
+
+    std::erase_if(retired_, [&held](const Generation *generation) {
+      if (std::ranges::find(held, generation) != held.end()) {
+        return false;
+      }
+      delete generation;
+      return true;
+    });
+  }
+
+  // with the writer_ locked
+  auto publish(Catalog catalog) -> void {
+    auto number = current_.load()->number + 1;
+    auto *next = new Generation{std::move(catalog), number};
+    retired_.push_back(current_.exchange(next));
+    reclaim();
+  }
+
+public:
+  /*
+   * A read-only view of one generation of the catalog, with all the lookups
+   * of SortedCatalog. Snapshots are meant to be short-lived (e.g. one per
+   * query): as long as one is held, its generation can't be reclaimed.
+   */
+  class Snapshot {
+    HazardSlot *slot_ = nullptr;
+    const Generation *generation_ = nullptr;
+
+  public:
+    Snapshot(HazardSlot &slot, const Generation &generation)
+        : slot_(&slot), generation_(&generation) {}
+
+    Snapshot(Snapshot &&other) noexcept
+        : slot_(std::exchange(other.slot_, nullptr)),
+          generation_(std::exchange(other.generation_, nullptr)) {}
+
+    auto operator=(Snapshot &&other) noexcept -> Snapshot & {
+      std::swap(slot_, other.slot_);
+      std::swap(generation_, other.generation_);
+      return *this;
+    }
+
+    ~Snapshot() {
+      if (slot_) {
+        slot_->hazard.store(nullptr, std::memory_order_release);
+      }
+    }
+
+    auto catalog() const -> const Catalog & { return generation_->catalog; }
+    auto operator->() const -> const Catalog * { return &catalog(); }
+
+    // increases with every published update, starting from 0
+    auto generation() const -> std::uint64_t { return generation_->number; }
+  };
+
+  /*
+   * At most max_snapshots snapshots can be held at the same time; taking one
+   * more throws std::length_error.
+   */
+  explicit SnapshotCatalog(Catalog catalog = {},
+                           std::size_t max_snapshots = 128)
+      : current_(new Generation{std::move(catalog), 0}),
+        slots_(max_snapshots) {}
+
+  SnapshotCatalog(const SnapshotCatalog &) = delete;
+  SnapshotCatalog &operator=(const SnapshotCatalog &) = delete;
+
+  // all the snapshots have to be released by now
+  ~SnapshotCatalog() {
+    for (const auto *generation : retired_) {
+      delete generation;
+    }
+    delete current_.load();
+  }
+
+  /*
+   * The reader side, lock-free.
+   *
+   * The generation is stored in the slot first, and then we check that it's
+   * still the current one: if it is, the writer either hasn't retired it yet,
+   * or will see it in the slot when it tries to free it. Otherwise, we retry
+   * with the newer one. Both the stores and the loads are sequentially
+   * consistent, so that the writer can't miss the hazard.
+   */
+  auto snapshot() -> Snapshot {
+    auto *generation = current_.load();
+    auto &slot = claim(generation);
+    while (true) {
+      auto *again = current_.load();
+      if (again == generation) {
+        return Snapshot(slot, *generation);
+      }
+      generation = again;
+      slot.hazard.store(generation);
+    }
+  }
+
+  /*
+   * The writer side: fn(catalog) updates a copy of the current catalog (e.g.
+   * stages new books), which is then committed and published. The readers
+   * don't see any of it until it's published.
+   */
+  template <typename Fn>
+    requires std::invocable<Fn &, Catalog &>
+  auto update(Fn fn) -> void {
+    auto lock = std::scoped_lock(writer_);
+    auto catalog = current_.load()->catalog;
+    fn(catalog);
+    catalog.commit();
+    publish(std::move(catalog));
+  }
+
+  // replaces the whole catalog, which is sorted from scratch
+  auto replace(const BooksConcept auto &books) -> void {
+    auto catalog = Catalog(books);
+    auto lock = std::scoped_lock(writer_);
+    publish(std::move(catalog));
+  }
+
+  // reclaims what it can; returns how many retired generations are still held
+  auto retired() -> std::size_t {
+    auto lock = std::scoped_lock(writer_);
+    reclaim();
+    return retired_.size();
+  }
+};
+
+/*
+ * Runtime test (atomics and threads): a writer keeps publishing bigger
+ * catalogs while readers check that every snapshot is sorted, complete and
+ * doesn't change while it's held. Run by ch03-differential.
+ */
+inline void snapshot_catalog_test() {
+  using Book = Book<std::string>;
+
+  auto catalog = SnapshotCatalog<Book>();
+
+  {
+    auto first = catalog.snapshot();
+    catalog.update([](auto &books) { books.stage({"Effective C++", "1"}); });
+    catalog.update([](auto &books) { books.stage({"Exceptional C++", "2"}); });
+
+    // the first generation is held, the second one is already reclaimed
+    runtime_check(first->empty() && first.generation() == 0);
+    runtime_check(catalog.retired() == 1);
+
+    auto second = catalog.snapshot();
+    runtime_check(second->size() == 2 && second.generation() == 2);
+    runtime_check(second->find("Exceptional C++")->isbn == "2");
+  }
+
+  catalog.replace(std::vector<Book>{{"C++ Concurrency in Action", "3"}});
+  runtime_check(catalog.retired() == 0);
+  runtime_check(catalog.snapshot()->size() == 1);
+
+  catalog.replace(std::vector<Book>{});
+  const auto base = catalog.snapshot().generation();
+
+  constexpr auto updates = 200;
+  auto done = std::atomic<bool>(false);
+  // a failed check can't throw out of a reader thread, so they count them
+  auto failures = std::atomic<int>(0);
+
+  auto readers = std::vector<std::jthread>();
+  for (auto reader = 0; reader < 3; ++reader) {
+    readers.emplace_back([&catalog, &done, &failures, base] {
+      auto last = base;
+      while (!done.load()) {
+        auto snapshot = catalog.snapshot();
+        const auto &books = snapshot.catalog();
+        // every update below adds one book
+        if (snapshot.generation() < last ||
+            books.size() != snapshot.generation() - base ||
+            !std::ranges::is_sorted(books, {}, &Book::title)) {
+          ++failures;
+        }
+        last = snapshot.generation();
+      }
+    });
+  }
+
+  for (auto i = 0; i < updates; ++i) {
+    catalog.update([i](auto &books) {
+      auto id = std::to_string(i * 7919 % updates);
+      books.stage({"Book #" + id, id});
+    });
+  }
+  done.store(true);
+  readers.clear();
+
+  runtime_check(failures.load() == 0);
+  runtime_check(catalog.snapshot()->size() == updates);
+  runtime_check(catalog.retired() == 0);
+}
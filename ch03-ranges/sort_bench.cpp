@@ -0,0 +1,351 @@
+/*
+ * Benchmark of the book sorting variants of sort_books.h on generated
+ * catalogs, to choose the sort strategy by the shape of the catalog.
+ *
+ *   ch03-sort-bench [--sizes=1000,1000000] [--shapes=random,sorted]
+ *                   [--repeat=5]
+ *
+ * Build it in Release mode (-DCMAKE_BUILD_TYPE=Release), the numbers of a
+ * debug build say little. Big catalogs need a lot of memory: 50M books take
+ * around 5 GB, twice that while sorting a copy.
+ *
+ * For every shape, size and variant it prints:
+ * - ns/elem: the median time over the repetitions, per book,
+ * - cmp/elem: the number of title comparisons, per book; counted in a
+ *   separate, untimed run with a title type that counts its comparisons,
+ * - allocs: the number of heap allocations made by the variant (the global
+ *   operator new is replaced below to count them).
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "random_books.h"
+#include "sort_books.h"
+
+namespace {
+auto allocations = std::atomic<std::uint64_t>(0);
+
+/*
+ * All the replaced operator new and delete below go through these two, so
+ * every allocation is counted, over-aligned and nothrow ones included, and is
+ * freed the way it was allocated.
+ */
+auto allocate(std::size_t size, std::size_t alignment) noexcept -> void * {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  size = std::max(size, std::size_t{1});
+  if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+    return std::malloc(size);
+  }
+  // aligned_alloc wants a multiple of the alignment
+  return std::aligned_alloc(alignment,
+                            (size + alignment - 1) / alignment * alignment);
+}
+
+auto deallocate(void *ptr) noexcept -> void { std::free(ptr); }
+
+auto allocate_or_throw(std::size_t size, std::size_t alignment) -> void * {
+  if (auto *ptr = allocate(size, alignment)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+} // namespace
+
+// the array forms and the nothrow deletes call these ones by default
+auto operator new(std::size_t size) -> void * {
+  return allocate_or_throw(size, 0);
+}
+auto operator new(std::size_t size, std::align_val_t alignment) -> void * {
+  return allocate_or_throw(size, static_cast<std::size_t>(alignment));
+}
+auto operator new(std::size_t size, const std::nothrow_t &) noexcept
+    -> void * {
+  return allocate(size, 0);
+}
+auto operator new(std::size_t size, std::align_val_t alignment,
+                  const std::nothrow_t &) noexcept -> void * {
+  return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+auto operator delete(void *ptr) noexcept -> void { deallocate(ptr); }
+auto operator delete(void *ptr, std::size_t) noexcept -> void {
+  deallocate(ptr);
+}
+auto operator delete(void *ptr, std::align_val_t) noexcept -> void {
+  deallocate(ptr);
+}
+auto operator delete(void *ptr, std::size_t, std::align_val_t) noexcept
+    -> void {
+  deallocate(ptr);
+}
+
+namespace {
+
+/*
+ * A title which counts how many times it's compared. It satisfies
+ * StringConcept, so Book<CountingString, std::string> works with every sort
+ * variant, exactly like Book<std::string>.
+ */
+struct CountingString {
+  inline static std::uint64_t comparisons = 0;
+
+  std::string str;
+
+  auto begin() const { return str.begin(); }
+  auto end() const { return str.end(); }
+
+  friend auto operator<=>(const CountingString &lhs, const CountingString &rhs)
+      -> std::strong_ordering {
+    ++comparisons;
+    return lhs.str <=> rhs.str;
+  }
+  friend auto operator==(const CountingString &lhs, const CountingString &rhs)
+      -> bool {
+    ++comparisons;
+    return lhs.str == rhs.str;
+  }
+};
+
+using TimedBook = Book<std::string>;
+using CountingBook = Book<CountingString, std::string>;
+
+/*
+ * The catalog shapes, of the books of random_books.h:
+ * - random: independent titles,
+ * - duplicates: 10 copies of every title on average,
+ * - sorted, reversed: already sorted in either direction,
+ * - runs: sorted runs of 1000 books, alternately ascending and descending,
+ *   like a concatenation of sorted shards.
+ */
+constexpr auto shapes = std::to_array<std::string_view>({
+    "random",
+    "duplicates",
+    "sorted",
+    "reversed",
+    "runs",
+});
+
+auto generate(std::string_view shape, std::size_t size)
+    -> std::vector<TimedBook> {
+  if (shape == "duplicates") {
+    return random_books(size, size, std::max(size / 10, std::size_t{1}));
+  }
+  auto books = random_books(size, size);
+
+  auto by_title = [](const TimedBook &lhs, const TimedBook &rhs) {
+    return lhs.title < rhs.title;
+  };
+  auto by_title_reversed = [&by_title](const TimedBook &lhs,
+                                       const TimedBook &rhs) {
+    return by_title(rhs, lhs);
+  };
+  if (shape == "sorted") {
+    std::ranges::sort(books, by_title);
+  } else if (shape == "reversed") {
+    std::ranges::sort(books, by_title_reversed);
+  } else if (shape == "runs") {
+    constexpr auto run = std::size_t{1000};
+    for (auto first = std::size_t{0}; first < size; first += run) {
+      auto last = books.begin() + std::min(first + run, size);
+      if (first / run % 2 == 0) {
+        std::sort(books.begin() + first, last, by_title);
+      } else {
+        std::sort(books.begin() + first, last, by_title_reversed);
+      }
+    }
+  }
+  return books;
+}
+
+/*
+ * The variants: the in-place sort<version>, both overloads of
+ * sorted<version>, the sort action, and std::ranges::sort with the two styles
+ * of key selection, a comparator lambda vs a projection, which is what
+ * sort<Version::Iterator> and sort<Version::Ranges> differ in (besides
+ * std::sort vs std::ranges::sort).
+ *
+ * Every variant gets a fresh copy of the input and returns the sorted books.
+ */
+template <typename BookType> struct Variant {
+  std::string_view name;
+  auto (*run)(std::vector<BookType> &books) -> std::vector<BookType>;
+};
+
+template <typename BookType> auto variants() {
+  using Books = std::vector<BookType>;
+  return std::to_array<Variant<BookType>>({
+      {"sort<Iterator>",
+       [](Books &books) {
+         sort<Version::Iterator>(books);
+         return std::move(books);
+       }},
+      {"sort<Ranges>",
+       [](Books &books) {
+         sort<Version::Ranges>(books);
+         return std::move(books);
+       }},
+      {"sorted<Iterator>(const&)",
+       [](Books &books) {
+         return sorted<Version::Iterator>(std::as_const(books));
+       }},
+      {"sorted<Ranges>(const&)",
+       [](Books &books) {
+         return sorted<Version::Ranges>(std::as_const(books));
+       }},
+      {"sorted<Ranges>(&&)",
+       [](Books &books) { return sorted<Version::Ranges>(std::move(books)); }},
+      {"actions::sort",
+       [](Books &books) {
+         return std::move(books) | actions::sort(&BookType::title);
+       }},
+      {"ranges::sort comparator",
+       [](Books &books) {
+         std::ranges::sort(books, [](const auto &lhs, const auto &rhs) {
+           return lhs.title < rhs.title;
+         });
+         return std::move(books);
+       }},
+      {"ranges::sort projection",
+       [](Books &books) {
+         std::ranges::sort(books, {}, &BookType::title);
+         return std::move(books);
+       }},
+  });
+}
+
+struct Options {
+  std::vector<std::size_t> sizes = {1'000, 10'000, 100'000, 1'000'000};
+  std::vector<std::string_view> shapes = {::shapes.begin(), ::shapes.end()};
+  int repeat = 5;
+};
+
+auto split(std::string_view list) -> std::vector<std::string_view> {
+  auto items = std::vector<std::string_view>();
+  for (auto item : list | std::views::split(',')) {
+    items.emplace_back(item.begin(), item.end());
+  }
+  return items;
+}
+
+auto parse_size(std::string_view str) -> std::size_t {
+  auto value = std::size_t{0};
+  auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+  if (ec != std::errc() || value == 0) {
+    std::fprintf(stderr, "invalid number: %.*s\n",
+                 static_cast<int>(str.size()), str.data());
+    std::exit(2);
+  }
+  // 1K, 50M and the like
+  auto suffix = std::string_view(ptr, str.data() + str.size());
+  return suffix == "K"   ? value * 1'000
+         : suffix == "M" ? value * 1'000'000
+                         : value;
+}
+
+auto parse(int argc, char *argv[]) -> Options {
+  auto options = Options();
+  for (auto i = 1; i < argc; ++i) {
+    auto arg = std::string_view(argv[i]);
+    if (arg.starts_with("--sizes=")) {
+      options.sizes.clear();
+      for (auto size : split(arg.substr(8))) {
+        options.sizes.push_back(parse_size(size));
+      }
+    } else if (arg.starts_with("--shapes=")) {
+      options.shapes = split(arg.substr(9));
+      for (auto shape : options.shapes) {
+        if (std::ranges::find(::shapes, shape) == ::shapes.end()) {
+          std::fprintf(stderr, "unknown shape: %.*s\n",
+                       static_cast<int>(shape.size()), shape.data());
+          std::exit(2);
+        }
+      }
+    } else if (arg.starts_with("--repeat=")) {
+      options.repeat = static_cast<int>(parse_size(arg.substr(9)));
+    } else {
+      std::fprintf(stderr,
+                   "usage: %s [--sizes=1K,1M,...] [--shapes=random,...] "
+                   "[--repeat=N]\n",
+                   argv[0]);
+      std::exit(2);
+    }
+  }
+  return options;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  auto options = parse(argc, argv);
+
+  std::printf("%-10s %10s  %-26s %10s %10s %10s\n", "shape", "size", "variant",
+              "ns/elem", "cmp/elem", "allocs");
+
+  for (auto shape : options.shapes) {
+    for (auto size : options.sizes) {
+      const auto input = generate(shape, size);
+      const auto counting_input = [&input] {
+        auto books = std::vector<CountingBook>();
+        books.reserve(input.size());
+        for (const auto &book : input) {
+          books.push_back({{book.title}, book.isbn});
+        }
+        return books;
+      }();
+
+      const auto timed = variants<TimedBook>();
+      const auto counted = variants<CountingBook>();
+      for (auto v = std::size_t{0}; v < timed.size(); ++v) {
+        auto times = std::vector<double>();
+        auto allocs = std::uint64_t{0};
+        for (auto r = 0; r < options.repeat; ++r) {
+          auto books = input;
+
+          auto allocs_before = allocations.load();
+          auto start = std::chrono::steady_clock::now();
+          auto result = timed[v].run(books);
+          auto stop = std::chrono::steady_clock::now();
+          allocs = allocations.load() - allocs_before;
+
+          times.push_back(
+              std::chrono::duration<double, std::nano>(stop - start).count());
+          if (!std::ranges::is_sorted(result, {}, &TimedBook::title)) {
+            std::fprintf(stderr, "%.*s didn't sort\n",
+                         static_cast<int>(timed[v].name.size()),
+                         timed[v].name.data());
+            return 1;
+          }
+        }
+        std::ranges::nth_element(times, times.begin() + times.size() / 2);
+
+        auto books = counting_input;
+        CountingString::comparisons = 0;
+        counted[v].run(books);
+        auto comparisons = CountingString::comparisons;
+
+        std::printf("%-10.*s %10zu  %-26.*s %10.1f %10.2f %10llu\n",
+                    static_cast<int>(shape.size()), shape.data(), size,
+                    static_cast<int>(timed[v].name.size()),
+                    timed[v].name.data(),
+                    times[times.size() / 2] / static_cast<double>(size),
+                    static_cast<double>(comparisons) /
+                        static_cast<double>(size),
+                    static_cast<unsigned long long>(allocs));
+        std::fflush(stdout);
+      }
+    }
+  }
+}
@@ -2,7 +2,11 @@
 
 #include "version.h"
 
+#include <algorithm>
+#include <functional>
+#include <ranges>
 #include <string>
+#include <type_traits>
 #include <utility>
 
 /*
@@ -21,12 +25,16 @@ concept StringConcept = std::ranges::range<T> && //
  * Nothing special here, except the detail that we define a type alias str_type
  * to check the underlying string type when checking a type against Book
  * concept.
+ *
+ * The isbn doesn't have to be a string: a packed type (see isbn.h) is both
+ * smaller and faster to compare. It defaults to the string type, though.
  */
-template <StringConcept String> struct Book {
+template <StringConcept String, std::regular IsbnType = String> struct Book {
   using str_type = String;
+  using isbn_type = IsbnType;
 
   String title;
-  String isbn;
+  IsbnType isbn;
 };
 
 /*
@@ -34,7 +42,8 @@ template <StringConcept String> struct Book {
  * the StringConcept, of course.
  */
 template <typename T>
-concept BookConcept = std::same_as<T, Book<typename T::str_type>>;
+concept BookConcept =
+    std::same_as<T, Book<typename T::str_type, typename T::isbn_type>>;
 
 /*
  * Here we implement an equality operator, but for the BookConcept rather that
@@ -111,18 +120,96 @@ constexpr auto sorted(const BooksConcept auto &books) {
   return copy;
 }
 
+/*
+ * The version above deep-copies the books even if the caller passes a temporary
+ * that nobody is going to look at afterwards. For rvalues, we can sort the
+ * books in place and move them out.
+ *
+ * Books is a forwarding reference here, so it's deduced as a reference type for
+ * lvalues, which we filter out with the requires-clause (they go to the const&
+ * overload above). Const rvalues are excluded as well, since we can't sort them.
+ */
+template <Version version, BooksConcept Books>
+  requires(!std::is_reference_v<Books> && !std::is_const_v<Books>)
+constexpr auto sorted(Books &&books) -> Books {
+  sort<version>(books);
+  return std::move(books);
+}
+
+/*
+ * Sort action for pipelines: unlike views, actions are eager and work with
+ * containers rather than views. The action takes ownership of the container,
+ * sorts it in place and passes it further down the pipeline:
+ *
+ *   auto books = load_books() | actions::sort(&Book::title);
+ *
+ * The design follows custom_take_view: actions::sort(proj) returns a closure,
+ * storing the projection only, and the closure gets the container via the
+ * overloaded | operator.
+ */
+namespace actions {
+namespace details {
+
+template <typename Proj> struct sort_action_closure {
+  Proj proj;
+
+  // only rvalues are accepted, as the action owns the container; for lvalues
+  // there's sort<version>, which makes mutation explicit
+  template <std::ranges::random_access_range R>
+    requires(!std::is_reference_v<R> && std::sortable<std::ranges::iterator_t<R>,
+                                                      std::ranges::less, Proj>)
+  constexpr auto operator()(R &&range) const -> R {
+    std::ranges::sort(range, {}, proj);
+    return std::move(range);
+  }
+};
+
+template <typename R, typename Proj>
+  requires std::invocable<const sort_action_closure<Proj> &, R>
+constexpr auto operator|(R &&range, const sort_action_closure<Proj> &action) {
+  return action(std::forward<R>(range));
+}
+
+} // namespace details
+
+struct sort_action {
+  template <typename Proj = std::identity>
+  constexpr auto operator()(Proj proj = {}) const {
+    return details::sort_action_closure<Proj>{std::move(proj)};
+  }
+};
+
+inline constexpr sort_action sort;
+
+} // namespace actions
+
 /*
  * Here our compile-time tests
  */
 struct sort_test {
   // helper function to test an implementation of a specific version
   template <Version version>
-  consteval auto test(const BooksConcept auto &input,
-                      const BooksConcept auto &expected) -> bool {
+  static consteval auto test(const BooksConcept auto &input,
+                             const BooksConcept auto &expected) -> bool {
     auto actual = sorted<version>(input);
     return std::ranges::equal(actual, expected);
   }
 
+  // the same, but for the rvalue overload of sorted
+  template <Version version>
+  static consteval auto test_rvalue(BooksConcept auto input,
+                                    const BooksConcept auto &expected) -> bool {
+    auto actual = sorted<version>(std::move(input));
+    return std::ranges::equal(actual, expected);
+  }
+
+  static consteval auto test_action(BooksConcept auto input,
+                                    const BooksConcept auto &expected) -> bool {
+    using BookType = std::ranges::range_value_t<decltype(input)>;
+    auto actual = std::move(input) | actions::sort(&BookType::title);
+    return std::ranges::equal(actual, expected);
+  }
+
   consteval auto operator()() -> void {
     using Book = Book<std::string_view>;
 
@@ -137,5 +224,10 @@ struct sort_test {
 
     static_assert(test<Version::Iterator>(input, expected));
     static_assert(test<Version::Ranges>(input, expected));
+
+    static_assert(test_rvalue<Version::Iterator>(input, expected));
+    static_assert(test_rvalue<Version::Ranges>(input, expected));
+
+    static_assert(test_action(input, expected));
   }
 };
\ No newline at end of file
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <ranges>
+#include <string_view>
+#include <vector>
+
+#include "sort_books.h"
+
+/*
+ * A book catalog which is always kept sorted by a projection (the title by
+ * default), so that it never has to be resorted as a whole.
+ *
+ * The books are stored in a flat sorted vector: lookups are binary searches,
+ * and scans are plain sequential reads over contiguous memory, which is hard to
+ * beat with node-based trees.
+ *
+ * The price is insertion: inserting a single book in the middle shifts half of
+ * the vector. That's why new books are staged first, and merged in batches by
+ * commit():
+ * - the batch is sorted on its own, O(k log k),
+ * - the vector grows by k, and the two sorted sequences are merged backwards,
+ *   from the end, into the free space, O(n + k), without extra memory.
+ *
+ * The backward merge only moves the books that go after the smallest new one,
+ * so appending books which are (mostly) greater than everything else is cheap.
+ *
+ * Staged books aren't visible to lookups until they're committed.
+ */
+template <BookConcept BookType, auto proj = &BookType::title>
+class SortedCatalog {
+  std::vector<BookType> books_;
+  std::vector<BookType> staged_;
+
+  constexpr static auto key(const BookType &book) -> decltype(auto) {
+    return std::invoke(proj, book);
+  }
+
+public:
+  using iterator = typename std::vector<BookType>::const_iterator;
+
+  SortedCatalog() = default;
+
+  constexpr explicit SortedCatalog(const BooksConcept auto &books) {
+    insert(books);
+  }
+
+  // buffers a book until the next commit
+  constexpr auto stage(BookType book) -> void {
+    staged_.push_back(std::move(book));
+  }
+
+  // merges all the staged books into the catalog
+  constexpr auto commit() -> void {
+    if (staged_.empty()) {
+      return;
+    }
+
+    std::ranges::sort(staged_, {}, proj);
+
+    auto old_size = books_.size();
+    books_.resize(old_size + staged_.size());
+
+    // i, j and out are "one past" positions, so that they never go below 0;
+    // when keys are equal, the staged book goes after the existing one
+    auto i = old_size;
+    auto j = staged_.size();
+    auto out = books_.size();
+    while (j > 0) {
+      if (i > 0 && key(staged_[j - 1]) < key(books_[i - 1])) {
+        books_[--out] = std::move(books_[--i]);
+      } else {
+        books_[--out] = std::move(staged_[--j]);
+      }
+    }
+
+    staged_.clear();
+  }
+
+  // stages and commits a whole batch at once
+  constexpr auto insert(const BooksConcept auto &books) -> void {
+    for (const auto &book : books) {
+      stage(book);
+    }
+    commit();
+  }
+
+  constexpr auto staged() const -> std::size_t { return staged_.size(); }
+
+  /*
+   * All the books with the given key, O(log n).
+   */
+  template <typename Key>
+  constexpr auto equal_range(const Key &value) const
+      -> std::ranges::subrange<iterator> {
+    return std::ranges::equal_range(books_, value, {}, proj);
+  }
+
+  // the first book with the given key, or nullptr
+  template <typename Key>
+  constexpr auto find(const Key &value) const -> const BookType * {
+    auto range = equal_range(value);
+    return range.empty() ? nullptr : &range.front();
+  }
+
+  /*
+   * All the books which keys start with the prefix, O(log n).
+   *
+   * Since the books are sorted, they form a contiguous block starting at the
+   * lower bound of the prefix. The end of the block is found with another
+   * binary search over the "starts with the prefix" predicate, which is true
+   * for the first part of the remaining range, and false for the rest.
+   */
+  constexpr auto prefix(std::string_view prefix) const
+      -> std::ranges::subrange<iterator> {
+    auto first = std::ranges::lower_bound(books_, prefix, {}, proj);
+    auto last = std::ranges::partition_point(
+        first, books_.end(), [prefix](const BookType &book) {
+          return std::string_view(key(book)).starts_with(prefix);
+        });
+    return {first, last};
+  }
+
+  constexpr auto size() const -> std::size_t { return books_.size(); }
+  constexpr auto empty() const -> bool { return books_.empty(); }
+
+  constexpr auto operator[](std::size_t i) const -> const BookType & {
+    return books_[i];
+  }
+
+  // only const access, as changing the keys would break the order
+  constexpr auto begin() const { return books_.begin(); }
+  constexpr auto end() const { return books_.end(); }
+};
+
+static_assert(BooksConcept<const SortedCatalog<Book<std::string_view>>>);
+
+/*
+ * Compile-time tests
+ */
+namespace sorted_catalog_test {
+
+using Book = Book<std::string_view>;
+
+consteval auto test_batches() -> bool {
+  auto catalog = SortedCatalog<Book>(std::to_array<Book>({
+      {"Functional programming in C++", "978-3-20-148410-0"},
+      {"Effective C++", "978-3-16-148410-0"},
+  }));
+
+  catalog.stage({"Effective Modern C++", "978-1-49-190399-5"});
+  catalog.stage({"C++ Concurrency in Action", "978-1-61-729469-3"});
+  catalog.stage({"The C++ Programming Language", "978-0-32-156384-2"});
+
+  // not visible yet
+  if (catalog.size() != 2 || catalog.find("Effective Modern C++")) {
+    return false;
+  }
+
+  catalog.commit();
+
+  return catalog.staged() == 0 &&
+         std::ranges::is_sorted(catalog, {}, &Book::title) &&
+         std::ranges::equal(catalog, std::to_array<Book>({
+                                         {"C++ Concurrency in Action",
+                                          "978-1-61-729469-3"},
+                                         {"Effective C++", "978-3-16-148410-0"},
+                                         {"Effective Modern C++",
+                                          "978-1-49-190399-5"},
+                                         {"Functional programming in C++",
+                                          "978-3-20-148410-0"},
+                                         {"The C++ Programming Language",
+                                          "978-0-32-156384-2"},
+                                     }));
+}
+
+consteval auto test_lookups() -> bool {
+  auto catalog = SortedCatalog<Book>(std::to_array<Book>({
+      {"Effective C++", "978-3-16-148410-0"},
+      {"Effective Modern C++", "978-1-49-190399-5"},
+      {"Effective STL", "978-0-20-174962-5"},
+      {"Exceptional C++", "978-0-20-161562-3"},
+  }));
+
+  // equal keys keep the insertion order across batches
+  catalog.insert(std::to_array<Book>({{"Effective C++", "978-0-32-133487-9"}}));
+
+  auto effective = catalog.prefix("Effective");
+  auto effective_cpp = catalog.equal_range("Effective C++");
+
+  return catalog.find("Effective STL")->isbn == "978-0-20-174962-5" &&
+         !catalog.find("Effective") && std::ranges::size(effective) == 4 &&
+         std::ranges::size(effective_cpp) == 2 &&
+         effective_cpp[1].isbn == "978-0-32-133487-9" &&
+         catalog.prefix("X").empty() &&
+         std::ranges::size(catalog.prefix("")) == catalog.size();
+}
+
+static_assert(test_batches());
+static_assert(test_lookups());
+
+} // namespace sorted_catalog_test
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "sort_books.h"
+#include "string_hash.h"
+
+/*
+ * A book catalog computed entirely at compile time: the books are sorted by
+ * title, and a minimal perfect hash table over the ISBNs is built for them.
+ *
+ * "Perfect" means no collisions: every ISBN of the catalog gets its own slot,
+ * so a lookup is a hash, a table read and a single compare, without probing.
+ * "Minimal" means there are exactly as many slots as books.
+ *
+ * The table is built with the "hash and displace" method:
+ * - the keys are distributed into buckets by a first hash,
+ * - then, starting from the largest bucket, we look for a seed for a second
+ *   hash, which puts all the keys of the bucket into distinct free slots,
+ * - the seeds are stored per bucket.
+ *
+ * A lookup is then slot = mix(h, seeds[mix(h, 0) % buckets]) % size, where h
+ * is the hash of the key.
+ *
+ * Everything lives in std::arrays of the catalog, so there's no heap usage and
+ * no startup cost at all: the whole thing is a constant in the binary.
+ */
+namespace static_catalog_details {
+
+// FNV-1a: the key is only hashed once, both for lookups and while building
+constexpr auto hash(std::string_view key) -> std::uint64_t {
+  auto h = 0xcbf29ce484222325ULL;
+  for (auto c : key) {
+    h = (h ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+  }
+  return h;
+}
+
+// derives a seeded hash from the key hash with the splitmix64 finalizer, so
+// trying another seed doesn't need another pass over the key
+constexpr auto mix(std::uint64_t h, std::uint64_t seed) -> std::uint64_t {
+  return mix64(h + seed * 0x9e3779b97f4a7c15ULL);
+}
+
+} // namespace static_catalog_details
+
+template <std::size_t N> struct StaticCatalog {
+  using BookType = Book<std::string_view>;
+
+  // sorted by title
+  std::array<BookType, N> books;
+  // seed of the second hash per bucket (there are as many buckets as books)
+  std::array<std::uint32_t, N> seeds;
+  // slot -> index into books
+  std::array<std::uint32_t, N> slots;
+
+  constexpr auto find(std::string_view isbn) const -> const BookType * {
+    using static_catalog_details::hash;
+    using static_catalog_details::mix;
+
+    if constexpr (N == 0) {
+      return nullptr;
+    } else {
+      auto h = hash(isbn);
+      auto bucket = mix(h, 0) % N;
+      auto slot = mix(h, seeds[bucket]) % N;
+      const auto &book = books[slots[slot]];
+      return book.isbn == isbn ? &book : nullptr;
+    }
+  }
+
+  constexpr auto size() const -> std::size_t { return N; }
+
+  constexpr auto begin() const { return books.begin(); }
+  constexpr auto end() const { return books.end(); }
+};
+
+/*
+ * The builder is consteval, so it can only run at compile time. Errors (such as
+ * duplicate ISBNs, for which no perfect hash exists) become compile errors,
+ * since throwing isn't a constant expression.
+ */
+template <std::size_t N>
+consteval auto
+make_static_catalog(std::array<Book<std::string_view>, N> books)
+    -> StaticCatalog<N> {
+  using static_catalog_details::hash;
+  using static_catalog_details::mix;
+
+  auto catalog = StaticCatalog<N>{};
+
+  sort<Version::Ranges>(books);
+  catalog.books = books;
+
+  if constexpr (N > 0) {
+    auto isbns = std::array<std::string_view, N>();
+    std::ranges::transform(books, isbns.begin(),
+                           &Book<std::string_view>::isbn);
+    std::ranges::sort(isbns);
+    if (std::ranges::adjacent_find(isbns) != isbns.end()) {
+      throw std::invalid_argument("duplicate ISBN in the catalog");
+    }
+
+    // indices of the books per bucket, the largest buckets are placed first,
+    // while there are still plenty of free slots
+    auto hashes = std::array<std::uint64_t, N>();
+    auto buckets = std::vector<std::vector<std::uint32_t>>(N);
+    for (auto i = std::uint32_t{0}; i < N; ++i) {
+      hashes[i] = hash(books[i].isbn);
+      buckets[mix(hashes[i], 0) % N].push_back(i);
+    }
+
+    auto order = std::array<std::uint32_t, N>();
+    for (auto i = std::uint32_t{0}; i < N; ++i) {
+      order[i] = i;
+    }
+    std::ranges::sort(order, std::ranges::greater{},
+                      [&](auto b) { return buckets[b].size(); });
+
+    auto taken = std::array<bool, N>();
+    auto candidates = std::vector<std::size_t>();
+
+    for (auto bucket : order) {
+      const auto &keys = buckets[bucket];
+      if (keys.empty()) {
+        break;
+      }
+
+      for (auto seed = std::uint32_t{1};; ++seed) {
+        candidates.clear();
+        for (auto key : keys) {
+          auto slot = mix(hashes[key], seed) % N;
+          if (taken[slot] || std::ranges::find(candidates, slot) !=
+                                 candidates.end()) {
+            break;
+          }
+          candidates.push_back(slot);
+        }
+
+        if (candidates.size() == keys.size()) {
+          catalog.seeds[bucket] = seed;
+          for (auto i = std::size_t{0}; i < keys.size(); ++i) {
+            taken[candidates[i]] = true;
+            catalog.slots[candidates[i]] = keys[i];
+          }
+          break;
+        }
+      }
+    }
+  }
+
+  return catalog;
+}
+
+/*
+ * Compile-time tests
+ */
+namespace static_catalog_test {
+
+using Book = Book<std::string_view>;
+
+constexpr auto catalog = make_static_catalog(std::to_array<Book>({
+    {"Functional programming in C++", "978-3-20-148410-0"},
+    {"Effective C++", "978-3-16-148410-0"},
+    {"The C++ Programming Language", "978-0-32-156384-2"},
+    {"C++ Concurrency in Action", "978-1-61-729469-3"},
+    {"Effective Modern C++", "978-1-49-190399-5"},
+    {"Effective STL", "978-0-20-174962-5"},
+    {"Exceptional C++", "978-0-20-161562-3"},
+}));
+
+static_assert(std::ranges::is_sorted(catalog, {}, &Book::title));
+
+consteval auto test_find() -> bool {
+  return std::ranges::all_of(catalog, [](const Book &book) {
+    return catalog.find(book.isbn) == &book;
+  });
+}
+
+static_assert(test_find());
+static_assert(catalog.find("978-0-00-000000-0") == nullptr);
+static_assert(catalog.find("") == nullptr);
+
+static_assert(make_static_catalog(std::array<Book, 0>{}).find("") == nullptr);
+
+} // namespace static_catalog_test
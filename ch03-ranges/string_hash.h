@@ -0,0 +1,78 @@
+#pragma once
+
+#include <concepts>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <type_traits>
+
+/*
+ * A fast string hash for the hash-based algorithms (dedupe, joins, etc.).
+ *
+ * FNV-1a is simple, but processes one byte per multiplication. Here we consume
+ * 8 bytes per step: every word is mixed in with a multiplication, and the
+ * result is finalized with the splitmix64 finalizer, so that all the bits of
+ * the hash depend on all the bytes (hash tables with power-of-two sizes use
+ * the low bits only).
+ *
+ * The words are assembled from bytes with shifts rather than read with memcpy,
+ * to keep the function constexpr; compilers turn that into a single load
+ * anyway.
+ */
+constexpr auto mix64(std::uint64_t x) -> std::uint64_t {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+constexpr auto hash_bytes(std::string_view str, std::uint64_t seed = 0)
+    -> std::uint64_t {
+  constexpr auto k = 0x9e3779b97f4a7c15ULL;
+
+  auto load = [&str](std::size_t pos, std::size_t count) {
+    auto word = std::uint64_t{0};
+    for (auto i = std::size_t{0}; i < count; ++i) {
+      auto byte = static_cast<unsigned char>(str[pos + i]);
+      word |= std::uint64_t{byte} << (8 * i);
+    }
+    return word;
+  };
+
+  auto h = seed ^ (str.size() * k);
+  auto pos = std::size_t{0};
+  for (; pos + 8 <= str.size(); pos += 8) {
+    h = (h ^ mix64(load(pos, 8))) * k;
+  }
+  if (pos < str.size()) {
+    h = (h ^ mix64(load(pos, str.size() - pos))) * k;
+  }
+  return mix64(h);
+}
+
+/*
+ * Hash function object: keys which carry their hash (see hashed_string.h)
+ * give it as is, strings (and anything convertible to string_view) go
+ * through hash_bytes, everything else through std::hash, with the result mixed
+ * again, as std::hash of integers is often the identity.
+ */
+struct key_hash {
+  using is_transparent = void;
+
+  template <typename Key>
+  constexpr auto operator()(const Key &key) const -> std::uint64_t {
+    if constexpr (requires {
+                    { key.hash() } -> std::same_as<std::uint64_t>;
+                  }) {
+      return key.hash();
+    } else if constexpr (std::is_convertible_v<const Key &, std::string_view>) {
+      return hash_bytes(key);
+    } else {
+      return mix64(std::hash<Key>()(key));
+    }
+  }
+};
+
+static_assert(hash_bytes("Effective C++") == hash_bytes("Effective C++"));
+static_assert(hash_bytes("Effective C++") != hash_bytes("Effective C+"));
+static_assert(hash_bytes("12345678") != hash_bytes("12345678", 1));
+static_assert(key_hash()(std::string_view("abc")) == hash_bytes("abc"));
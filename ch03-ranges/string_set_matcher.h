@@ -0,0 +1,243 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "book_catalog.h"
+#include "strings_equal.h"
+#include "version.h"
+
+/*
+ * Checking a token against a set of a few hundred keywords. Comparing the token
+ * with every keyword in turn costs k string compares, each of them with its
+ * own branches and loads.
+ *
+ * Here every keyword is summarized by a 4-byte fingerprint: its length and its
+ * first, middle and last bytes. The fingerprints are stored in one array, and
+ * the fingerprint of the token is compared with 8 (AVX2) or 4 (SSE2) of them
+ * at a time. Only the keywords with the same fingerprint, which almost always
+ * means just the right one, are compared as strings.
+ *
+ * There are two flavours: static_string_set_matcher for fixed keyword sets,
+ * which is built at compile time, and string_set_matcher, which is built at
+ * runtime and owns copies of its keywords.
+ */
+namespace string_set_details {
+
+// the fingerprint array is padded to a multiple of this, so that the vector
+// loads never go past its end
+constexpr auto lanes = std::size_t{8};
+
+constexpr auto padded(std::size_t size) -> std::size_t {
+  return (size + lanes - 1) / lanes * lanes;
+}
+
+constexpr auto fingerprint(std::string_view str) -> std::uint32_t {
+  if (str.empty()) {
+    return 0;
+  }
+  auto byte = [](char c) {
+    return std::uint32_t{static_cast<unsigned char>(c)};
+  };
+  auto length =
+      static_cast<std::uint32_t>(std::min(str.size(), std::size_t{255}));
+  return byte(str.front()) | byte(str[str.size() / 2]) << 8 |
+         byte(str.back()) << 16 | length << 24;
+}
+
+/*
+ * A bit per fingerprint of the block equal to print, from the lowest; the
+ * block has step fingerprints.
+ */
+#if defined(__AVX2__)
+constexpr auto step = std::size_t{8};
+
+inline auto match_mask(const std::uint32_t *block, std::uint32_t print)
+    -> unsigned {
+  auto prints = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block));
+  auto equal = _mm256_cmpeq_epi32(
+      prints, _mm256_set1_epi32(static_cast<int>(print)));
+  return static_cast<unsigned>(
+      _mm256_movemask_ps(_mm256_castsi256_ps(equal)));
+}
+#elif defined(__SSE2__)
+constexpr auto step = std::size_t{4};
+
+inline auto match_mask(const std::uint32_t *block, std::uint32_t print)
+    -> unsigned {
+  auto prints = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block));
+  auto equal =
+      _mm_cmpeq_epi32(prints, _mm_set1_epi32(static_cast<int>(print)));
+  return static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(equal)));
+}
+#else
+constexpr auto step = std::size_t{1};
+
+inline auto match_mask(const std::uint32_t *block, std::uint32_t print)
+    -> unsigned {
+  return *block == print ? 1 : 0;
+}
+#endif
+
+static_assert(lanes % step == 0);
+
+/*
+ * Returns the index of the first key equal to the token; fingerprints has
+ * padded(keys.size()) elements. Intrinsics aren't usable at compile time, so
+ * the fingerprints are compared one by one there.
+ */
+constexpr auto find(std::span<const std::uint32_t> fingerprints,
+                    std::span<const std::string_view> keys,
+                    std::string_view token) -> std::optional<std::size_t> {
+  const auto print = fingerprint(token);
+  auto confirm = [&](std::size_t index) {
+    return index < keys.size() &&
+           strings_equal<Version::Simd>(keys[index], token);
+  };
+
+  if consteval {
+    for (auto i = std::size_t{0}; i < keys.size(); ++i) {
+      if (fingerprints[i] == print && confirm(i)) {
+        return i;
+      }
+    }
+  } else {
+    for (auto i = std::size_t{0}; i < fingerprints.size(); i += step) {
+      auto mask = match_mask(fingerprints.data() + i, print);
+      for (; mask != 0; mask &= mask - 1) {
+        auto index = i + static_cast<std::size_t>(std::countr_zero(mask));
+        if (confirm(index)) {
+          return index;
+        }
+      }
+    }
+  }
+  return std::nullopt;
+}
+
+} // namespace string_set_details
+
+/*
+ * The compile-time flavour: the keywords are string_views (usually literals),
+ * and everything else is computed by the constexpr constructor.
+ *
+ *   constexpr auto keywords = static_string_set_matcher(
+ *       std::to_array<std::string_view>({"if", "else", "while"}));
+ */
+template <std::size_t N> class static_string_set_matcher {
+  std::array<std::string_view, N> keys_;
+  std::array<std::uint32_t, string_set_details::padded(N)> fingerprints_{};
+
+public:
+  constexpr explicit static_string_set_matcher(
+      const std::array<std::string_view, N> &keys)
+      : keys_(keys) {
+    std::ranges::transform(keys_, fingerprints_.begin(),
+                           string_set_details::fingerprint);
+  }
+
+  // the index of the keyword equal to the token
+  constexpr auto find(std::string_view token) const
+      -> std::optional<std::size_t> {
+    return string_set_details::find(fingerprints_, keys_, token);
+  }
+
+  constexpr auto contains(std::string_view token) const -> bool {
+    return find(token).has_value();
+  }
+
+  constexpr auto operator[](std::size_t i) const -> std::string_view {
+    return keys_[i];
+  }
+  constexpr auto size() const -> std::size_t { return N; }
+};
+
+/*
+ * The runtime flavour, for keyword sets known only at runtime (e.g. loaded
+ * from a config). The keywords are copied into an arena (see book_catalog.h),
+ * so the matcher doesn't depend on the lifetime of the input.
+ */
+class string_set_matcher {
+  StringArena arena_;
+  std::vector<std::string_view> keys_;
+  std::vector<std::uint32_t> fingerprints_;
+
+public:
+  template <std::ranges::input_range R>
+    requires std::convertible_to<std::ranges::range_reference_t<R>,
+                                 std::string_view>
+  constexpr explicit string_set_matcher(R &&keys)
+      : arena_(StringArena::default_chunk_size / 16) {
+    for (std::string_view key : keys) {
+      keys_.push_back(arena_.store(key));
+      fingerprints_.push_back(string_set_details::fingerprint(key));
+    }
+    fingerprints_.resize(string_set_details::padded(keys_.size()));
+  }
+
+  constexpr auto find(std::string_view token) const
+      -> std::optional<std::size_t> {
+    return string_set_details::find(fingerprints_, keys_, token);
+  }
+
+  constexpr auto contains(std::string_view token) const -> bool {
+    return find(token).has_value();
+  }
+
+  constexpr auto operator[](std::size_t i) const -> std::string_view {
+    return keys_[i];
+  }
+  constexpr auto size() const -> std::size_t { return keys_.size(); }
+};
+
+/*
+ * Compile-time tests
+ */
+namespace string_set_matcher_test {
+
+constexpr auto keywords = std::to_array<std::string_view>({
+    "alignas", "alignof", "auto",     "bool",      "break",  "case",
+    "char",    "class",   "concept",  "consteval", "const",  "constexpr",
+    "",        "co_await", "requires", "return",   "static", "struct",
+});
+
+constexpr auto matcher = static_string_set_matcher(keywords);
+
+template <typename Matcher>
+constexpr auto test(const Matcher &matcher) -> bool {
+  auto all_found = true;
+  for (auto i = std::size_t{0}; i < keywords.size(); ++i) {
+    all_found = all_found && matcher.find(keywords[i]) == i;
+  }
+
+  // "clads" has the same fingerprint as "class", so it's rejected by the
+  // string compare only; the others differ in the length or in a byte
+  return all_found && !matcher.contains("clads") &&
+         !matcher.contains("constant") && !matcher.contains("cas") &&
+         !matcher.contains("alignoff") && !matcher.contains("co_yield");
+}
+
+static_assert(test(matcher));
+static_assert(matcher.size() == keywords.size() && matcher[2] == "auto");
+
+consteval auto test_runtime_builder() -> bool {
+  auto matcher = string_set_matcher(keywords);
+  return test(matcher) && matcher.size() == keywords.size() &&
+         string_set_matcher(std::vector<std::string_view>{}).find("") ==
+             std::nullopt;
+}
+
+static_assert(test_runtime_builder());
+
+} // namespace string_set_matcher_test
@@ -1,38 +1,137 @@
 #pragma once
 
 #include <algorithm>
+#include <cstring>
 #include <ranges>
 #include <string>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 #include "version.h"
 
+/*
+ * The strings are taken as string_views: std::string converts implicitly, and
+ * literals don't have to be copied into temporary std::strings just to be
+ * compared.
+ */
 template <Version v>
-constexpr bool strings_equal(const std::string &lhs, const std::string &rhs);
+constexpr bool strings_equal(std::string_view lhs, std::string_view rhs);
 
 template <>
-constexpr bool strings_equal<Version::Iterator>(const std::string &lhs,
-                                                const std::string &rhs) {
+constexpr bool strings_equal<Version::Iterator>(std::string_view lhs,
+                                                std::string_view rhs) {
   // downsides:
   // - code duplication (repetitions of begins, ends, and container names)
   //
   // advantages:
   // - partial application of the algorithm (although quite rare)
-  return std::equal(lhs.begin(), lhs.end(), rhs.begin());
+  //
+  // rhs.end() is important: with the three-iterator std::equal, the algorithm
+  // assumes rhs is at least as long as lhs, and reads past its end otherwise
+  return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
 }
 
 template <>
-constexpr bool strings_equal<Version::Ranges>(const std::string &lhs,
-                                              const std::string &rhs) {
+constexpr bool strings_equal<Version::Ranges>(std::string_view lhs,
+                                              std::string_view rhs) {
   // drops the need for writing begins and ends repetitively,
   // now it's easy to see that the algorithm is applied to the collections as
   // wholes
   return std::ranges::equal(lhs, rhs);
 }
 
+/*
+ * Different sizes mean different strings, which is decided before looking at
+ * a single character. Equally sized strings are compared a vector at a time:
+ * a byte compare gives 0xFF for every equal pair of bytes, movemask collects
+ * the top bits of all the bytes into an integer, and the vectors are equal if
+ * all the bits are set. AVX2 compares 32 bytes at a time, SSE2 16, and the
+ * loop does two vectors per iteration.
+ *
+ * The tail never reads past the strings: the last vector is loaded so that it
+ * ends exactly at the end of the strings (overlapping bytes which are already
+ * compared, which is harmless), and strings shorter than a vector go to
+ * memcmp.
+ *
+ * Intrinsics aren't usable at compile time, so there's the scalar path for
+ * that (see also Isbn::parse).
+ */
+namespace strings_equal_details {
+
+#if defined(__AVX2__)
+constexpr auto vector_size = std::size_t{32};
+
+inline auto equal_vectors(const char *lhs, const char *rhs) -> bool {
+  auto l = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lhs));
+  auto r = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rhs));
+  return _mm256_movemask_epi8(_mm256_cmpeq_epi8(l, r)) == -1;
+}
+#elif defined(__SSE2__)
+constexpr auto vector_size = std::size_t{16};
+
+inline auto equal_vectors(const char *lhs, const char *rhs) -> bool {
+  auto l = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lhs));
+  auto r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rhs));
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(l, r)) == 0xFFFF;
+}
+#endif
+
+inline auto equal_simd(const char *lhs, const char *rhs, std::size_t size)
+    -> bool {
+#if defined(__SSE2__)
+  // memcmp with null pointers is undefined even for 0 bytes, and a
+  // default-constructed string_view has a null data()
+  if (size < vector_size) {
+    return size == 0 || std::memcmp(lhs, rhs, size) == 0;
+  }
+
+  auto pos = std::size_t{0};
+  for (; pos + 2 * vector_size <= size; pos += 2 * vector_size) {
+    // both compares are done before branching
+    auto first = equal_vectors(lhs + pos, rhs + pos);
+    auto second = equal_vectors(lhs + pos + vector_size,
+                                rhs + pos + vector_size);
+    if (!(first & second)) {
+      return false;
+    }
+  }
+  if (pos + vector_size <= size && !equal_vectors(lhs + pos, rhs + pos)) {
+    return false;
+  }
+  return equal_vectors(lhs + size - vector_size, rhs + size - vector_size);
+#else
+  return size == 0 || std::memcmp(lhs, rhs, size) == 0;
+#endif
+}
+
+} // namespace strings_equal_details
+
+template <>
+constexpr bool strings_equal<Version::Simd>(std::string_view lhs,
+                                            std::string_view rhs) {
+  if (lhs.size() != rhs.size()) {
+    return false;
+  }
+  if consteval {
+    return std::ranges::equal(lhs, rhs);
+  } else {
+    return strings_equal_details::equal_simd(lhs.data(), rhs.data(),
+                                             lhs.size());
+  }
+}
+
 template <Version version> constexpr void strings_equal_test() {
   static_assert(!strings_equal<version>("Hello", "Bello"));
   static_assert(strings_equal<version>("Hello", "Hello"));
+  // prefixes in both directions
+  static_assert(!strings_equal<version>("Hello", "Hell"));
+  static_assert(!strings_equal<version>("Hell", "Hello"));
+  static_assert(strings_equal<version>("", ""));
 }
 
 static_assert((strings_equal_test<Version::Iterator>(), true));
 static_assert((strings_equal_test<Version::Ranges>(), true));
+static_assert((strings_equal_test<Version::Simd>(), true));
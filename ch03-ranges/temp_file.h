@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+/*
+ * A temporary file, removed when the object goes out of scope (an exception
+ * or not). Nothing is created, the object only reserves a unique name: the
+ * counter makes the names unique within the process, the random part across
+ * processes sharing the directory (e.g. the debug and the release build of the
+ * tests running at the same time).
+ *
+ * Used for the runs of the external sort, the autotuner cache while it's
+ * written, and the files of the runtime tests.
+ */
+class TempFile {
+  std::filesystem::path path_;
+
+public:
+  explicit TempFile(std::string_view name,
+                    const std::filesystem::path &dir =
+                        std::filesystem::temp_directory_path()) {
+    static auto counter = std::atomic<std::uint64_t>(0);
+    static const auto salt = std::random_device()();
+
+    path_ = dir / (std::string(name) + "-" + std::to_string(salt) + "-" +
+                   std::to_string(counter++));
+  }
+
+  TempFile(TempFile &&other) noexcept
+      : path_(std::exchange(other.path_, {})) {}
+  TempFile &operator=(TempFile &&) = delete;
+
+  ~TempFile() {
+    if (!path_.empty()) {
+      auto ec = std::error_code();
+      std::filesystem::remove(path_, ec);
+    }
+  }
+
+  auto path() const -> const std::filesystem::path & { return path_; }
+};
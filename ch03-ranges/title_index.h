@@ -0,0 +1,525 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "runtime_check.h"
+#include "sort_books.h"
+
+/*
+ * Search index over book titles, answering two kinds of queries:
+ * - prefix: all the titles starting with a string (autocomplete),
+ * - substring: all the titles containing a string.
+ *
+ * All the titles are concatenated into a single text, separated by '\0', and
+ * the index consists of:
+ * - the suffix array: the start positions of all the suffixes of the text, in
+ *   sorted order; all the suffixes starting with a pattern form a contiguous
+ *   block, which is found by binary search,
+ * - the LCP array: the length of the longest common prefix of every suffix with
+ *   the previous one; once the first match is found, the rest of the block is
+ *   collected by walking the LCP array while it's at least the pattern length,
+ *   without comparing any more strings,
+ * - the same two arrays for the titles only (title ids in title order, and the
+ *   LCPs of adjacent titles), for prefix queries.
+ *
+ * The binary searches remember how many characters of the pattern are already
+ * known to match the lower and upper bounds of the search range: every string
+ * in between shares at least the smaller of the two, so the comparisons start
+ * from there. In practice that makes a search O(|p| + log n) rather than
+ * O(|p| log n) (the latter is still the worst case).
+ *
+ * Title ids are positions of the books in the range the index is built from.
+ *
+ * Everything is stored in flat arrays of 32-bit integers, so the index can be
+ * saved to a file as is and memory-mapped back (see MappedTitleIndex), which
+ * makes loading a large index instant: the pages are read lazily by the OS.
+ */
+
+/*
+ * The query logic works on a non-owning view of the arrays, so that it's the
+ * same for the in-memory and memory-mapped indices.
+ */
+class TitleIndexView {
+public:
+  std::string_view text;
+  // title id -> offset in the text; one extra entry at the end (text size)
+  std::span<const std::uint32_t> starts;
+  // suffix array (without the suffixes starting at separators) and its LCPs
+  std::span<const std::uint32_t> suffixes;
+  std::span<const std::uint32_t> suffix_lcp;
+  // title ids in title order and the LCPs of adjacent titles
+  std::span<const std::uint32_t> order;
+  std::span<const std::uint32_t> order_lcp;
+
+  constexpr auto size() const -> std::size_t { return order.size(); }
+
+  constexpr auto title(std::uint32_t id) const -> std::string_view {
+    // minus the separator
+    return text.substr(starts[id], starts[id + 1] - starts[id] - 1);
+  }
+
+  /*
+   * Ids of the titles starting with the prefix, in title order.
+   */
+  constexpr auto prefix(std::string_view prefix) const
+      -> std::vector<std::uint32_t> {
+    auto [first, last] =
+        find(prefix, order, order_lcp, [this](std::uint32_t id) {
+          return title(id);
+        });
+    return {order.begin() + first, order.begin() + last};
+  }
+
+  /*
+   * Ids of the titles containing the pattern, in ascending order.
+   */
+  constexpr auto substring(std::string_view pattern) const
+      -> std::vector<std::uint32_t> {
+    // empty titles have no suffixes (except the separator), but they do
+    // contain the empty string
+    if (pattern.empty()) {
+      auto ids = std::vector<std::uint32_t>(size());
+      std::iota(ids.begin(), ids.end(), std::uint32_t{0});
+      return ids;
+    }
+
+    auto [first, last] =
+        find(pattern, suffixes, suffix_lcp,
+             [this](std::uint32_t pos) { return text.substr(pos); });
+
+    auto ids = std::vector<std::uint32_t>();
+    ids.reserve(last - first);
+    for (auto i = first; i < last; ++i) {
+      // the title containing the suffix start
+      auto it = std::ranges::upper_bound(starts, suffixes[i]);
+      ids.push_back(static_cast<std::uint32_t>(it - starts.begin() - 1));
+    }
+
+    // a title can contain the pattern multiple times
+    std::ranges::sort(ids);
+    auto [tail, _] = std::ranges::unique(ids);
+    ids.erase(tail, ids.end());
+    return ids;
+  }
+
+private:
+  /*
+   * Finds the block of the strings starting with the pattern in a sorted
+   * array, see the comments above.
+   */
+  template <typename Str>
+  constexpr static auto find(std::string_view pattern,
+                             std::span<const std::uint32_t> sorted,
+                             std::span<const std::uint32_t> lcp, Str str)
+      -> std::pair<std::size_t, std::size_t> {
+    auto lo = std::size_t{0};
+    auto hi = sorted.size();
+    // matching characters with the strings just before lo and at hi
+    auto lcp_lo = std::size_t{0};
+    auto lcp_hi = std::size_t{0};
+
+    while (lo < hi) {
+      auto mid = lo + (hi - lo) / 2;
+      auto s = str(sorted[mid]);
+
+      auto matched = std::min(lcp_lo, lcp_hi);
+      while (matched < pattern.size() && matched < s.size() &&
+             s[matched] == pattern[matched]) {
+        ++matched;
+      }
+
+      // is the string less than the pattern (when cut to its length)?
+      auto less = matched < pattern.size() &&
+                  (matched == s.size() ||
+                   static_cast<unsigned char>(s[matched]) <
+                       static_cast<unsigned char>(pattern[matched]));
+      if (less) {
+        lo = mid + 1;
+        lcp_lo = matched;
+      } else {
+        hi = mid;
+        lcp_hi = matched;
+      }
+    }
+
+    if (lo == sorted.size() || !str(sorted[lo]).starts_with(pattern)) {
+      return {lo, lo};
+    }
+
+    auto last = lo + 1;
+    while (last < sorted.size() && lcp[last] >= pattern.size()) {
+      ++last;
+    }
+    return {lo, last};
+  }
+};
+
+namespace title_index_details {
+
+/*
+ * Suffix array by prefix doubling: after the round for k, the suffixes are
+ * sorted by their first 2k characters, and rank[i] is the rank of suffix i
+ * by that criterion. The next round sorts by (rank[i], rank[i + k]) pairs.
+ *
+ * O(n log^2 n) with a comparison sort, which is fine for title catalogs; a
+ * linear-time construction (SA-IS) would be the next step for huge texts.
+ */
+constexpr auto build_suffix_array(std::string_view text)
+    -> std::vector<std::uint32_t> {
+  const auto n = text.size();
+  auto sa = std::vector<std::uint32_t>(n);
+  std::iota(sa.begin(), sa.end(), std::uint32_t{0});
+
+  auto rank = std::vector<std::uint32_t>(n);
+  for (auto i = std::size_t{0}; i < n; ++i) {
+    rank[i] = static_cast<unsigned char>(text[i]);
+  }
+
+  auto next = std::vector<std::uint32_t>(n);
+  for (auto k = std::size_t{1}; n > 1; k *= 2) {
+    // 0 is reserved for "past the end", which goes before everything
+    auto key = [&](std::uint32_t i) {
+      return std::pair(rank[i], i + k < n ? rank[i + k] + 1 : 0);
+    };
+    std::ranges::sort(sa, {}, key);
+
+    next[sa[0]] = 0;
+    for (auto i = std::size_t{1}; i < n; ++i) {
+      next[sa[i]] = next[sa[i - 1]] + (key(sa[i - 1]) < key(sa[i]) ? 1 : 0);
+    }
+    std::swap(rank, next);
+
+    if (rank[sa[n - 1]] == n - 1) {
+      break; // all the ranks are distinct
+    }
+  }
+
+  return sa;
+}
+
+/*
+ * Kasai's algorithm: the LCP of suffix i + 1 with its predecessor is at least
+ * the LCP of suffix i with its predecessor minus one, so the matched length
+ * only drops by one per step, and the total work is O(n).
+ */
+constexpr auto build_lcp(std::string_view text,
+                         const std::vector<std::uint32_t> &sa)
+    -> std::vector<std::uint32_t> {
+  const auto n = text.size();
+  auto rank = std::vector<std::uint32_t>(n);
+  for (auto i = std::size_t{0}; i < n; ++i) {
+    rank[sa[i]] = static_cast<std::uint32_t>(i);
+  }
+
+  auto lcp = std::vector<std::uint32_t>(n);
+  auto h = std::size_t{0};
+  for (auto i = std::size_t{0}; i < n; ++i) {
+    if (rank[i] == 0) {
+      h = 0;
+      continue;
+    }
+    auto j = sa[rank[i] - 1];
+    while (i + h < n && j + h < n && text[i + h] == text[j + h]) {
+      ++h;
+    }
+    lcp[rank[i]] = static_cast<std::uint32_t>(h);
+    h = h > 0 ? h - 1 : 0;
+  }
+  return lcp;
+}
+
+constexpr auto common_prefix(std::string_view lhs, std::string_view rhs)
+    -> std::uint32_t {
+  auto [l, _] = std::ranges::mismatch(lhs, rhs);
+  return static_cast<std::uint32_t>(l - lhs.begin());
+}
+
+/*
+ * The file layout: the header, then the text padded to 4 bytes, then all the
+ * arrays one after another.
+ */
+struct FileHeader {
+  char magic[8];
+  std::uint64_t text_size;
+  std::uint64_t title_count;
+  std::uint64_t suffix_count;
+};
+
+constexpr char file_magic[8] = {'T', 'I', 'T', 'L', 'E', 'I', 'X', '1'};
+
+constexpr auto padded(std::size_t size) -> std::size_t {
+  return (size + 3) / 4 * 4;
+}
+
+} // namespace title_index_details
+
+/*
+ * The in-memory index, built from a range of books.
+ */
+class TitleIndex {
+  std::vector<char> text_;
+  std::vector<std::uint32_t> starts_;
+  std::vector<std::uint32_t> suffixes_;
+  std::vector<std::uint32_t> suffix_lcp_;
+  std::vector<std::uint32_t> order_;
+  std::vector<std::uint32_t> order_lcp_;
+
+public:
+  constexpr explicit TitleIndex(const BooksConcept auto &books) {
+    using namespace title_index_details;
+
+    for (const auto &book : books) {
+      starts_.push_back(static_cast<std::uint32_t>(text_.size()));
+      text_.insert(text_.end(), std::ranges::begin(book.title),
+                   std::ranges::end(book.title));
+      text_.push_back('\0');
+    }
+    starts_.push_back(static_cast<std::uint32_t>(text_.size()));
+
+    const auto text = std::string_view(text_.data(), text_.size());
+    const auto count = starts_.size() - 1;
+
+    // the suffixes starting with the separators are never matched, and since
+    // '\0' is the smallest character, they're all at the beginning
+    auto sa = build_suffix_array(text);
+    auto lcp = build_lcp(text, sa);
+    suffixes_.assign(sa.begin() + count, sa.end());
+    suffix_lcp_.assign(lcp.begin() + count, lcp.end());
+    if (!suffix_lcp_.empty()) {
+      suffix_lcp_[0] = 0;
+    }
+
+    order_.resize(count);
+    std::iota(order_.begin(), order_.end(), std::uint32_t{0});
+    std::ranges::sort(order_, {}, [this](std::uint32_t id) -> std::string_view {
+      return view().title(id);
+    });
+
+    order_lcp_.resize(count);
+    for (auto i = std::size_t{1}; i < count; ++i) {
+      order_lcp_[i] = common_prefix(view().title(order_[i - 1]),
+                                    view().title(order_[i]));
+    }
+  }
+
+  constexpr auto view() const -> TitleIndexView {
+    return {std::string_view(text_.data(), text_.size()),
+            starts_,
+            suffixes_,
+            suffix_lcp_,
+            order_,
+            order_lcp_};
+  }
+
+  constexpr auto prefix(std::string_view prefix) const {
+    return view().prefix(prefix);
+  }
+  constexpr auto substring(std::string_view pattern) const {
+    return view().substring(pattern);
+  }
+
+  auto save(const std::filesystem::path &path) const -> void {
+    using namespace title_index_details;
+
+    auto file = std::ofstream(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      throw std::runtime_error("cannot create index file " + path.string());
+    }
+
+    auto header = FileHeader{{}, text_.size(), order_.size(), suffixes_.size()};
+    std::memcpy(header.magic, file_magic, sizeof(file_magic));
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    const char padding[4] = {};
+    file.write(text_.data(), static_cast<std::streamsize>(text_.size()));
+    file.write(padding, static_cast<std::streamsize>(padded(text_.size()) -
+                                                     text_.size()));
+
+    for (const auto *array :
+         {&starts_, &suffixes_, &suffix_lcp_, &order_, &order_lcp_}) {
+      file.write(reinterpret_cast<const char *>(array->data()),
+                 static_cast<std::streamsize>(array->size() *
+                                              sizeof(std::uint32_t)));
+    }
+
+    if (!file.flush()) {
+      throw std::runtime_error("cannot write index file " + path.string());
+    }
+  }
+};
+
+/*
+ * An index saved with TitleIndex::save, mapped into memory. Only the header is
+ * read on opening, the rest is paged in on demand.
+ */
+class MappedTitleIndex {
+  void *data_ = nullptr;
+  std::size_t size_ = 0;
+  TitleIndexView view_;
+
+public:
+  explicit MappedTitleIndex(const std::filesystem::path &path) {
+    using namespace title_index_details;
+
+    auto fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("cannot open index file " + path.string());
+    }
+
+    struct stat st {};
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+      size_ = static_cast<std::size_t>(st.st_size);
+      data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    // the mapping stays valid after closing the descriptor
+    ::close(fd);
+
+    if (data_ == nullptr || data_ == MAP_FAILED) {
+      data_ = nullptr;
+      throw std::runtime_error("cannot map index file " + path.string());
+    }
+
+    auto header = FileHeader();
+    auto *bytes = static_cast<const char *>(data_);
+    if (size_ < sizeof(header)) {
+      unmap();
+      throw std::runtime_error("corrupted index file " + path.string());
+    }
+    std::memcpy(&header, bytes, sizeof(header));
+
+    const auto array_bytes = (3 * header.title_count + 1 +
+                              2 * header.suffix_count) *
+                             sizeof(std::uint32_t);
+    if (std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0 ||
+        size_ != sizeof(header) + padded(header.text_size) + array_bytes) {
+      unmap();
+      throw std::runtime_error("corrupted index file " + path.string());
+    }
+
+    bytes += sizeof(header);
+    view_.text = std::string_view(bytes, header.text_size);
+    bytes += padded(header.text_size);
+
+    auto next = [&bytes](std::size_t count) {
+      auto array = std::span(reinterpret_cast<const std::uint32_t *>(bytes),
+                             count);
+      bytes += count * sizeof(std::uint32_t);
+      return array;
+    };
+    view_.starts = next(header.title_count + 1);
+    view_.suffixes = next(header.suffix_count);
+    view_.suffix_lcp = next(header.suffix_count);
+    view_.order = next(header.title_count);
+    view_.order_lcp = next(header.title_count);
+  }
+
+  MappedTitleIndex(const MappedTitleIndex &) = delete;
+  MappedTitleIndex &operator=(const MappedTitleIndex &) = delete;
+
+  MappedTitleIndex(MappedTitleIndex &&other) noexcept
+      : data_(std::exchange(other.data_, nullptr)),
+        size_(std::exchange(other.size_, 0)), view_(other.view_) {}
+
+  MappedTitleIndex &operator=(MappedTitleIndex &&other) noexcept {
+    if (this != &other) {
+      unmap();
+      data_ = std::exchange(other.data_, nullptr);
+      size_ = std::exchange(other.size_, 0);
+      view_ = other.view_;
+    }
+    return *this;
+  }
+
+  ~MappedTitleIndex() { unmap(); }
+
+  auto view() const -> const TitleIndexView & { return view_; }
+
+  auto prefix(std::string_view prefix) const { return view_.prefix(prefix); }
+  auto substring(std::string_view pattern) const {
+    return view_.substring(pattern);
+  }
+
+private:
+  auto unmap() -> void {
+    if (data_ != nullptr) {
+      ::munmap(data_, size_);
+      data_ = nullptr;
+    }
+  }
+};
+
+/*
+ * Compile-time tests
+ */
+namespace title_index_test {
+
+using Book = Book<std::string_view>;
+
+constexpr auto books = std::to_array<Book>({
+    {"Functional programming in C++", "978-3-20-148410-0"},
+    {"Effective C++", "978-3-16-148410-0"},
+    {"The C++ Programming Language", "978-0-32-156384-2"},
+    {"C++ Concurrency in Action", "978-1-61-729469-3"},
+    {"Effective Modern C++", "978-1-49-190399-5"},
+    {"Effective STL", "978-0-20-174962-5"},
+});
+
+template <typename... Ids>
+constexpr auto ids(Ids... values) -> std::vector<std::uint32_t> {
+  return {static_cast<std::uint32_t>(values)...};
+}
+
+consteval auto test_prefix() -> bool {
+  auto index = TitleIndex(books);
+  return index.prefix("Effective") == ids(1, 4, 5) &&
+         index.prefix("Effective M") == ids(4) &&
+         index.prefix("C++") == ids(3) && index.prefix("c++").empty() &&
+         index.prefix("Effective C++ and more").empty() &&
+         index.prefix("").size() == books.size();
+}
+
+consteval auto test_substring() -> bool {
+  auto index = TitleIndex(books);
+  return index.substring("C++") == ids(0, 1, 2, 3, 4) &&
+         index.substring("ing") == ids(0, 2) &&
+         index.substring("Action") == ids(3) &&
+         index.substring("e C") == ids(1, 2) &&
+         index.substring("Java").empty() &&
+         index.substring("").size() == books.size() &&
+         // the separators don't make titles match across their boundaries
+         index.substring("++Effective").empty();
+}
+
+static_assert(test_prefix());
+static_assert(test_substring());
+
+} // namespace title_index_test
+
+/*
+ * Runtime test for the on-disk form, run by ch03-differential
+ */
+inline void title_index_file_test() {
+  auto file = TempFile("title_index_test");
+
+  TitleIndex(title_index_test::books).save(file.path());
+  auto index = MappedTitleIndex(file.path());
+  runtime_check(index.prefix("Effective") == title_index_test::ids(1, 4, 5));
+  runtime_check(index.substring("C++") ==
+                title_index_test::ids(0, 1, 2, 3, 4));
+  runtime_check(index.view().title(2) == "The C++ Programming Language");
+}
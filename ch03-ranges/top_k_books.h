@@ -0,0 +1,294 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <ranges>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "parallel.h"
+#include "sort_books.h"
+#include "version.h"
+
+/*
+ * Most of the time, we only need the first page of a listing, but
+ * sort<version> orders the whole catalog, O(n log n). Here we only keep the k
+ * smallest books in a bounded max-heap, with the largest of them on top: every
+ * next book either goes after the top and is dropped right away, or replaces
+ * the top. That's O(n log k), and only k books are ever copied.
+ *
+ * This is exactly what partial_sort_copy does under the hood. It only needs to
+ * read the input once, so it works for input ranges too.
+ *
+ * The result is sorted and contains min(k, size) books. Like with sort<version>,
+ * the order of books with equal keys is unspecified.
+ */
+
+// the projection defaults to the title for all the versions
+template <typename Books>
+using TitleProj = decltype(&std::ranges::range_value_t<Books>::title);
+
+/*
+ * The output of partial_sort_copy has to hold elements already; these are
+ * copies of the first min(k, size) books rather than k default-constructed
+ * ones: k may be way larger than the catalog, and a book with a title type
+ * without a default constructor is a book too.
+ */
+template <BooksConcept Books>
+constexpr auto top_k_buffer(const Books &books, std::size_t k) {
+  auto buffer = std::vector<std::ranges::range_value_t<Books>>();
+  for (auto it = std::ranges::begin(books);
+       buffer.size() < k && it != std::ranges::end(books); ++it) {
+    buffer.push_back(*it);
+  }
+  return buffer;
+}
+
+template <Version version, BooksConcept Books, typename Proj = TitleProj<Books>>
+  requires VersionIterator<version>
+constexpr auto top_k(const Books &books, std::size_t k,
+                     Proj proj = &std::ranges::range_value_t<Books>::title) {
+  auto cmp = [&proj](const auto &lhs, const auto &rhs) {
+    return std::invoke(proj, lhs) < std::invoke(proj, rhs);
+  };
+
+  auto result = top_k_buffer(books, k);
+  auto last = std::partial_sort_copy(std::begin(books), std::end(books),
+                                     result.begin(), result.end(), cmp);
+  result.erase(last, result.end());
+  return result;
+}
+
+template <Version version, BooksConcept Books, typename Proj = TitleProj<Books>>
+  requires VersionRanges<version>
+constexpr auto top_k(const Books &books, std::size_t k,
+                     Proj proj = &std::ranges::range_value_t<Books>::title) {
+  // the projection is applied to both the input and the result elements
+  auto result = top_k_buffer(books, k);
+  auto [_, last] =
+      std::ranges::partial_sort_copy(books, result, {}, proj, proj);
+  result.erase(last, result.end());
+  return result;
+}
+
+/*
+ * Every thread selects the top k of its chunk, then the top k of those
+ * (at most threads * k books) is selected once again.
+ */
+template <Version version, BooksConcept Books, typename Proj = TitleProj<Books>>
+  requires VersionParallel<version> && std::ranges::random_access_range<Books>
+auto top_k(const Books &books, std::size_t k,
+           Proj proj = &std::ranges::range_value_t<Books>::title) {
+  using BookType = std::ranges::range_value_t<Books>;
+
+  const auto size = static_cast<std::size_t>(std::ranges::distance(books));
+  const auto chunks = chunk_count(size);
+  if (chunks == 1) {
+    return top_k<Version::Ranges>(books, k, proj);
+  }
+
+  auto partial = std::vector<std::vector<BookType>>(chunks);
+  parallel_chunks(size, chunks,
+                  [&](std::size_t chunk, std::size_t first, std::size_t last) {
+                    auto begin = std::ranges::begin(books);
+                    auto slice = std::ranges::subrange(begin + first,
+                                                       begin + last);
+                    partial[chunk] = top_k<Version::Ranges>(slice, k, proj);
+                  });
+
+  auto candidates = std::vector<BookType>();
+  candidates.reserve(std::min(chunks * k, size));
+  for (auto &chunk : partial) {
+    std::ranges::move(chunk, std::back_inserter(candidates));
+  }
+
+  return top_k<Version::Ranges>(candidates, k, proj);
+}
+
+/*
+ * Streaming versions: the input is read exactly once and never materialized,
+ * so it can be a generator, a file reader, or any other input range.
+ */
+template <Version version, std::ranges::input_range Books,
+          typename Proj = TitleProj<Books>>
+  requires VersionIterator<version> &&
+           BookConcept<std::ranges::range_value_t<Books>>
+constexpr auto top_k_stream(Books &&books, std::size_t k,
+                            Proj proj =
+                                &std::ranges::range_value_t<Books>::title) {
+  using BookType = std::ranges::range_value_t<Books>;
+
+  auto cmp = [&proj](const auto &lhs, const auto &rhs) {
+    return std::invoke(proj, lhs) < std::invoke(proj, rhs);
+  };
+
+  // the max-heap of the k smallest books seen so far, maintained by hand; k
+  // may be way larger than the input, so it's only reserved up front when the
+  // input size is known
+  auto heap = std::vector<BookType>();
+  if constexpr (std::ranges::sized_range<Books>) {
+    heap.reserve(
+        std::min(k, static_cast<std::size_t>(std::ranges::size(books))));
+  }
+
+  auto it = std::ranges::begin(books);
+  auto end = std::ranges::end(books);
+  for (; k > 0 && it != end; ++it) {
+    if (heap.size() < k) {
+      heap.push_back(*it);
+      std::push_heap(heap.begin(), heap.end(), cmp);
+    } else if (cmp(*it, heap.front())) {
+      std::pop_heap(heap.begin(), heap.end(), cmp);
+      heap.back() = *it;
+      std::push_heap(heap.begin(), heap.end(), cmp);
+    }
+  }
+
+  std::sort_heap(heap.begin(), heap.end(), cmp);
+  return heap;
+}
+
+template <Version version, std::ranges::input_range Books,
+          typename Proj = TitleProj<Books>>
+  requires VersionRanges<version> &&
+           BookConcept<std::ranges::range_value_t<Books>>
+constexpr auto top_k_stream(Books &&books, std::size_t k,
+                            Proj proj =
+                                &std::ranges::range_value_t<Books>::title) {
+  using BookType = std::ranges::range_value_t<Books>;
+
+  // the input isn't accessed via a const reference, as many input ranges
+  // (e.g. generators) can't be iterated when const; and as it can only be
+  // read once, the max-heap is filled as it goes, like with the iterators
+  auto heap = std::vector<BookType>();
+  for (auto &&book : books) {
+    if (heap.size() < k) {
+      heap.push_back(book);
+      std::ranges::push_heap(heap, {}, proj);
+    } else if (k > 0 && std::invoke(proj, book) <
+                            std::invoke(proj, heap.front())) {
+      std::ranges::pop_heap(heap, {}, proj);
+      heap.back() = book;
+      std::ranges::push_heap(heap, {}, proj);
+    }
+  }
+
+  std::ranges::sort_heap(heap, {}, proj);
+  return heap;
+}
+
+/*
+ * The input is read in blocks, and every block is reduced in parallel together
+ * with the current top k. So only a block of books is in memory at a time.
+ */
+template <Version version, std::ranges::input_range Books,
+          typename Proj = TitleProj<Books>>
+  requires VersionParallel<version> &&
+           BookConcept<std::ranges::range_value_t<Books>>
+auto top_k_stream(Books &&books, std::size_t k,
+                  Proj proj = &std::ranges::range_value_t<Books>::title,
+                  std::size_t block_size = std::size_t{1} << 20) {
+  using BookType = std::ranges::range_value_t<Books>;
+
+  // the top k carried over is never more than the books read so far, while k
+  // may be way larger than the input
+  auto block = std::vector<BookType>();
+  block.reserve(block_size);
+
+  auto it = std::ranges::begin(books);
+  auto end = std::ranges::end(books);
+  while (it != end) {
+    for (auto i = std::size_t{0}; i < block_size && it != end; ++i, ++it) {
+      block.push_back(*it);
+    }
+
+    // the result of the previous blocks becomes a part of the next block
+    auto top = top_k<Version::Parallel>(block, k, proj);
+    block = std::move(top);
+    block.reserve(block_size + block.size());
+  }
+
+  // the loop above didn't run if the input was empty
+  return top_k<Version::Ranges>(block, k, proj);
+}
+
+/*
+ * Compile-time tests (the parallel versions use threads and are runtime-only)
+ */
+namespace top_k_test {
+
+using Book = Book<std::string_view>;
+
+constexpr auto input = std::to_array<Book>({
+    {"Functional programming in C++", "978-3-20-148410-0"},
+    {"Effective C++", "978-3-16-148410-0"},
+    {"The C++ Programming Language", "978-0-32-156384-2"},
+    {"C++ Concurrency in Action", "978-1-61-729469-3"},
+    {"Effective Modern C++", "978-1-49-190399-5"},
+});
+
+constexpr auto expected = std::to_array<Book>({
+    {"C++ Concurrency in Action", "978-1-61-729469-3"},
+    {"Effective C++", "978-3-16-148410-0"},
+    {"Effective Modern C++", "978-1-49-190399-5"},
+});
+
+template <Version version> consteval auto test() -> bool {
+  // a single-pass view over the input, to check input ranges are fine
+  auto stream = std::views::iota(std::size_t{0}, input.size()) |
+                std::views::transform([](auto i) { return input[i]; });
+
+  return std::ranges::equal(top_k<version>(input, 3), expected) &&
+         std::ranges::equal(top_k_stream<version>(stream, 3), expected) &&
+         top_k<version>(input, 10).size() == input.size() &&
+         top_k_stream<version>(input, std::size_t{1} << 40).size() ==
+             input.size() &&
+         top_k<version>(input, 0).empty() &&
+         top_k<version>(input, 1, &Book::isbn)[0].isbn == "978-0-32-156384-2";
+}
+
+static_assert(test<Version::Iterator>());
+static_assert(test<Version::Ranges>());
+
+// a title without a default constructor, so neither has the book
+struct Title {
+  std::string_view str;
+
+  constexpr explicit Title(std::string_view str) : str(str) {}
+
+  constexpr auto begin() const { return str.begin(); }
+  constexpr auto end() const { return str.end(); }
+
+  constexpr auto operator<=>(const Title &) const = default;
+};
+
+using TitledBook = ::Book<Title, std::string_view>;
+static_assert(!std::is_default_constructible_v<TitledBook>);
+
+template <Version version> consteval auto test_titled() -> bool {
+  auto books = std::to_array<TitledBook>({
+      {Title("Effective STL"), "3"},
+      {Title("Effective C++"), "1"},
+      {Title("Effective Modern C++"), "2"},
+  });
+  auto isbns = [](const auto &top) {
+    auto isbns = std::vector<std::string_view>();
+    for (const auto &book : top) {
+      isbns.push_back(book.isbn);
+    }
+    return isbns;
+  };
+
+  return isbns(top_k<version>(books, 2)) ==
+             std::vector<std::string_view>{"1", "2"} &&
+         isbns(top_k_stream<version>(books, 5)) ==
+             std::vector<std::string_view>{"1", "2", "3"};
+}
+
+static_assert(test_titled<Version::Iterator>());
+static_assert(test_titled<Version::Ranges>());
+
+} // namespace top_k_test
@@ -1,18 +1,70 @@
 #pragma once
 
+#include <array>
+#include <string_view>
+
 enum class Version {
   Iterator,
   Ranges,
+  Parallel,
+  Simd,
 };
 
+/*
+ * For the tools which pick or report versions at runtime (autotuner.h).
+ */
+constexpr auto all_versions = std::to_array<Version>({
+    Version::Iterator,
+    Version::Ranges,
+    Version::Parallel,
+    Version::Simd,
+});
+
+constexpr auto version_name(Version version) -> std::string_view {
+  switch (version) {
+  case Version::Iterator:
+    return "Iterator";
+  case Version::Ranges:
+    return "Ranges";
+  case Version::Parallel:
+    return "Parallel";
+  case Version::Simd:
+    return "Simd";
+  }
+  return "?";
+}
+
 template <Version version>
 concept VersionIterator = (version == Version::Iterator);
 
 template <Version version>
 concept VersionRanges = (version == Version::Ranges);
 
+template <Version version>
+concept VersionParallel = (version == Version::Parallel);
+
+template <Version version>
+concept VersionSimd = (version == Version::Simd);
+
 static_assert(VersionIterator<Version::Iterator>);
 static_assert(!VersionIterator<Version::Ranges>);
+static_assert(!VersionIterator<Version::Parallel>);
+static_assert(!VersionIterator<Version::Simd>);
 
 static_assert(VersionRanges<Version::Ranges>);
 static_assert(!VersionRanges<Version::Iterator>);
+static_assert(!VersionRanges<Version::Parallel>);
+static_assert(!VersionRanges<Version::Simd>);
+
+static_assert(VersionParallel<Version::Parallel>);
+static_assert(!VersionParallel<Version::Iterator>);
+static_assert(!VersionParallel<Version::Ranges>);
+static_assert(!VersionParallel<Version::Simd>);
+
+static_assert(VersionSimd<Version::Simd>);
+static_assert(!VersionSimd<Version::Iterator>);
+static_assert(!VersionSimd<Version::Ranges>);
+static_assert(!VersionSimd<Version::Parallel>);
+
+static_assert(version_name(Version::Parallel) == "Parallel");
+static_assert(version_name(all_versions.back()) == "Simd");
@@ -0,0 +1,136 @@
+/*
+ * Benchmarks of the comparison operators of the chapter, see bench/bench.h:
+ * the six hand-written operators of String<Version::Cpp17> against the
+ * operator<=> of String<Version::Cpp20>, and the custom operator<=> of
+ * Address.
+ *
+ *   ch06-bench [--filter=String] [--max-size=64K] [--json=ch06.json]
+ */
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "02_ordering_comparison.h"
+#include "08_custom_sort_order.h"
+#include "bench.h"
+#include "version.h"
+
+namespace {
+
+auto version_name(Version version) -> std::string_view {
+  return version == Version::Cpp17 ? "Cpp17" : "Cpp20";
+}
+
+/*
+ * String only takes char arrays, and counts their whole size, so the strings
+ * are all of the same length. A small alphabet makes them share prefixes,
+ * and the comparisons go past the first bytes.
+ */
+struct Chars {
+  char data[16];
+};
+
+auto random_chars(std::size_t size) -> std::vector<Chars> {
+  auto rng = std::mt19937_64(size);
+  auto chars = std::vector<Chars>(size);
+  for (auto &str : chars) {
+    std::ranges::generate(str.data,
+                          [&] { return static_cast<char>('a' + rng() % 4); });
+  }
+  return chars;
+}
+
+template <Version version>
+auto strings_of(const std::vector<Chars> &chars)
+    -> std::vector<String<version>> {
+  auto strings = std::vector<String<version>>();
+  strings.reserve(chars.size());
+  for (const auto &str : chars) {
+    strings.emplace_back(str.data);
+  }
+  return strings;
+}
+
+auto random_addresses(std::size_t size) -> std::vector<Address> {
+  constexpr auto cities = std::to_array<std::string_view>(
+      {"Berlin", "Boston", "Bristol", "Brno"});
+  constexpr auto streets = std::to_array<std::string_view>(
+      {"Main Street", "Market Street", "Mill Lane", "Station Road"});
+
+  auto rng = std::mt19937_64(size);
+  auto addresses = std::vector<Address>();
+  addresses.reserve(size);
+  for (auto i = std::size_t{0}; i < size; ++i) {
+    addresses.push_back({std::string(cities[rng() % cities.size()]),
+                         std::string(streets[rng() % streets.size()]),
+                         static_cast<std::uint32_t>(rng() % 200)});
+  }
+  return addresses;
+}
+
+auto registry() -> bench::Registry {
+  auto registry = bench::Registry();
+  const auto sizes = std::vector<std::size_t>{1'000, 10'000, 100'000};
+
+  // String isn't assignable (it has a const member), so its indices are
+  // sorted instead, with operator<
+  registry.add<Version::Cpp17, Version::Cpp20>(
+      "String sort", sizes, version_name,
+      []<Version version>(std::size_t size) -> bench::Case {
+        auto chars = std::make_shared<std::vector<Chars>>(random_chars(size));
+        auto strings = std::make_shared<std::vector<String<version>>>(
+            strings_of<version>(*chars));
+        auto indices = std::make_shared<std::vector<std::uint32_t>>(size);
+        return {[strings, indices] {
+                  std::ranges::sort(*indices, [&](auto lhs, auto rhs) {
+                    return (*strings)[lhs] < (*strings)[rhs];
+                  });
+                  bench::do_not_optimize(*indices);
+                },
+                // chars owns the characters the strings point to
+                [chars, indices] {
+                  std::iota(indices->begin(), indices->end(), 0);
+                }};
+      });
+
+  // operator==, counting the copies of one of the strings
+  registry.add<Version::Cpp17, Version::Cpp20>(
+      "String count", sizes, version_name,
+      []<Version version>(std::size_t size) -> bench::Case {
+        auto chars = std::make_shared<std::vector<Chars>>(random_chars(size));
+        auto strings = strings_of<version>(*chars);
+        auto needle = strings.front();
+        return {[chars, strings, needle] {
+          auto count = std::ranges::count(strings, needle);
+          bench::do_not_optimize(count);
+        }};
+      });
+
+  // there's only the C++20 way for Address
+  registry.add<Version::Cpp20>(
+      "Address sort", sizes, version_name,
+      []<Version>(std::size_t size) -> bench::Case {
+        auto input = random_addresses(size);
+        auto addresses = std::make_shared<std::vector<Address>>();
+        return {[addresses] {
+                  std::ranges::sort(*addresses);
+                  bench::do_not_optimize(*addresses);
+                },
+                [addresses, input] { *addresses = input; }};
+      });
+
+  return registry;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  return bench::main(argc, argv, registry());
+}
@@ -0,0 +1,69 @@
+/*
+ * Differential testing of the comparison operators of the chapter, see
+ * bench/differential.h: the six hand-written operators of
+ * String<Version::Cpp17> have to agree with the ones the compiler derives
+ * from operator<=> and operator== of String<Version::Cpp20>.
+ *
+ *   ch06-differential [--seeds=100]
+ */
+
+#include <algorithm>
+#include <array>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include "02_ordering_comparison.h"
+#include "differential.h"
+#include "version.h"
+
+namespace {
+
+auto version_name(Version version) -> std::string_view {
+  return version == Version::Cpp17 ? "Cpp17" : "Cpp20";
+}
+
+/*
+ * String only takes char arrays (see bench.cpp). With two letters, a lot of
+ * the pairs are equal or share long prefixes.
+ */
+struct Chars {
+  char data[8];
+};
+
+auto differential() -> bench::Differential {
+  auto differential = bench::Differential();
+
+  // size is the number of pairs; the result holds all six operators of every
+  // pair
+  differential.add<Version::Cpp17, Version::Cpp20>(
+      "String operators", {1, 1'000, 100'000}, version_name,
+      [](std::mt19937_64 &rng, std::size_t size) {
+        auto chars = std::vector<Chars>(size * 2);
+        for (auto &str : chars) {
+          std::ranges::generate(
+              str.data, [&] { return static_cast<char>('a' + rng() % 2); });
+        }
+        return chars;
+      },
+      []<Version version>(std::vector<Chars> chars) {
+        using Str = String<version>;
+
+        auto results = std::vector<std::array<bool, 6>>();
+        for (auto i = std::size_t{0}; i + 1 < chars.size(); i += 2) {
+          auto lhs = Str(chars[i].data);
+          auto rhs = Str(chars[i + 1].data);
+          results.push_back({lhs == rhs, lhs != rhs, lhs < rhs, lhs <= rhs,
+                             lhs > rhs, lhs >= rhs});
+        }
+        return results;
+      });
+
+  return differential;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  return bench::differential_main(argc, argv, differential());
+}